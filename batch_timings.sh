@@ -1,10 +1,13 @@
 #!/bin/bash
 
+# Usage: batch_timings.sh [algorithm], where algorithm is posixmt (default)
+# or update. Updates use the default delta of 0, so data.h5 stays valid.
+algorithm=${1:-posixmt}
+
 for n_threads in 1 2 4 8 16 32 64
 do
     for i in {1..5}
     do
-        time ./reader -a posixmt -n $n_threads data.h5 2>&1 | tee -a bt.out
+        time ./reader -a $algorithm -n $n_threads data.h5 2>&1 | tee -a bt.out
     done
 done
-
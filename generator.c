@@ -3,6 +3,7 @@
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <hdf5.h>
 
@@ -13,109 +14,143 @@ usage(void)
 {
     printf("\n");
     printf("HDF5 multi-threaded I/O work-around\n");
-    printf("Generates an HDF5 file containing a single, chunked, 1D dataset\n");
+    printf("Generates an HDF5 file containing a single 1D dataset\n");
     printf("for use with the reader program.\n");
     printf("\n");
-    printf("Usage: generator <filename>\n");
+    printf("Usage: generator [options] <filename>\n");
     printf("\n");
     printf("Options:\n");
+    printf("\td\tDataset size in elements (default is DSET_SIZE)\n");
+    printf("\tc\tChunk size in elements (default is CHUNK_SIZE)\n");
+    printf("\te\tElement type (uint8|uint16|uint32|uint64|float|double, default is uint32)\n");
+    printf("\tl\tDataset layout (chunked|contiguous|compact, default is chunked)\n");
+    printf("\t\tCompact datasets are COMPACT_BYTES bytes instead of -d elements\n");
+    printf("\tv\tCreate a virtual dataset split across this many chunked source files\n");
+    printf("\t\tnamed <filename>.src<n> (default: no)\n");
     printf("\t?\tPrint this help information\n");
     printf("\n");
 } /* usage */
 
+/* Records the pattern's block size on the dataset, since only chunked
+ * datasets carry it in their layout
+ */
 int
-main(int argc, char *argv[])
+write_chunk_size_attr(hid_t did, hsize_t chunk_size)
+{
+    hid_t sid = H5I_INVALID_HID;
+    hid_t aid = H5I_INVALID_HID;
+
+    uint64_t val = chunk_size;
+
+    if (H5I_INVALID_HID == (sid = H5Screate(H5S_SCALAR)))
+        goto error;
+    if (H5I_INVALID_HID == (aid = H5Acreate2(did, CHUNK_SIZE_ATTR_NAME, H5T_STD_U64LE, sid, H5P_DEFAULT, H5P_DEFAULT)))
+        goto error;
+    if (H5Awrite(aid, H5T_NATIVE_UINT64, &val) < 0)
+        goto error;
+
+    if (H5Aclose(aid) < 0)
+        goto error;
+    if (H5Sclose(sid) < 0)
+        goto error;
+
+    return 0;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Aclose(aid);
+        H5Sclose(sid);
+    } H5E_END_TRY;
+
+    return -1;
+} /* write_chunk_size_attr */
+
+/* Creates the dataset and fills it. first_element is where the dataset
+ * starts in the overall element numbering, which is non-zero for the
+ * source datasets of a virtual dataset.
+ */
+int
+write_dataset(hid_t fid, H5D_layout_t layout, hsize_t dims, hsize_t chunk_size, elem_type_e type,
+        hsize_t first_element)
 {
-    hid_t fid = H5I_INVALID_HID;
     hid_t tid = H5I_INVALID_HID;
     hid_t dcpl_id = H5I_INVALID_HID;
     hid_t did = H5I_INVALID_HID;
     hid_t msid = H5I_INVALID_HID;
     hid_t fsid = H5I_INVALID_HID;
 
-    hsize_t dims = DSET_SIZE;
-    hsize_t chunk_dims = CHUNK_SIZE;
+    hsize_t chunk_dims = chunk_size;
+    hsize_t block = chunk_size;
 
     hsize_t offset = 0;
     hsize_t count = 0;
 
-    uint32_t chunk_n = 0;
-    uint32_t *buf = NULL;
-
-    int c;
-
-    char *filename = NULL;
-
+    uint64_t chunk_n = 0;
+    void *buf = NULL;
 
-    while ((c = getopt(argc, argv, ":")) != -1) {
-        switch (c) {
-            case '?':
-                usage();
-                exit(EXIT_SUCCESS);
-        }
-    }
-
-    /* File name is the last argument */
-    if (optind != argc - 1) {
-        printf("\n");
-        printf("BADNESS: Data file name must be last parameter\n");
-        printf("\n");
-        usage();
-        exit(EXIT_FAILURE);
-    }
-    else
-        filename = argv[optind];
-
-    printf("HDF5 multithreaded I/O work-around - generator\n");
+    /* Write in blocks of one chunk, or the whole thing if it's smaller. HDF5
+     * won't make a chunk bigger than a fixed-size dataset either, which
+     * happens to the last source of a virtual dataset.
+     */
+    if (dims < block)
+        block = dims;
+    if (dims < chunk_dims)
+        chunk_dims = dims;
 
     /**********************/
     /* Create HDF5 things */
     /**********************/
 
-    if (H5I_INVALID_HID == (fid = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT)))
-        goto error;
-
-    if (H5I_INVALID_HID == (tid = H5Tcopy(H5T_NATIVE_UINT32)))
+    if (H5I_INVALID_HID == (tid = H5Tcopy(elem_type_native(type))))
         goto error;
 
     if (H5I_INVALID_HID == (fsid = H5Screate_simple(1, &dims, &dims)))
         goto error;
 
-    if (H5I_INVALID_HID == (msid = H5Screate_simple(1, &chunk_dims, &chunk_dims)))
+    if (H5I_INVALID_HID == (msid = H5Screate_simple(1, &block, &block)))
         goto error;
 
     if (H5I_INVALID_HID == (dcpl_id = H5Pcreate(H5P_DATASET_CREATE)))
         goto error;
-    if (H5Pset_chunk(dcpl_id, 1, &chunk_dims) < 0)
+    if (H5D_CHUNKED == layout) {
+        if (H5Pset_chunk(dcpl_id, 1, &chunk_dims) < 0)
+            goto error;
+    }
+    else if (H5Pset_layout(dcpl_id, layout) < 0)
         goto error;
 
     if (H5I_INVALID_HID == (did = H5Dcreate2(fid, DATASET_NAME, tid, fsid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)))
         goto error;
 
+    if (write_chunk_size_attr(did, chunk_size) < 0)
+        goto error;
+
     /**************/
     /* Write data */
     /**************/
 
-    if (NULL == (buf = malloc(CHUNK_SIZE * sizeof(uint32_t))))
+    if (NULL == (buf = malloc(block * elem_type_sizes[type])))
         goto error;
 
-    count = CHUNK_SIZE;
-    chunk_n = 0;
-
-    for (hsize_t u = 0; u < DSET_SIZE; u += CHUNK_SIZE) {
+    /* Every element holds the number of the chunk_size block it falls in,
+     * whatever the layout, so the reader verifies all of them the same way.
+     */
+    for (hsize_t u = 0; u < dims; u += block) {
 
         offset = u;
+        count = (dims - u < block) ? dims - u : block;
+        chunk_n = (first_element + u) / chunk_size;
 
         if (H5Sselect_hyperslab(fsid, H5S_SELECT_SET, &offset, NULL, &count, NULL) < 0)
             goto error;
+        offset = 0;
+        if (H5Sselect_hyperslab(msid, H5S_SELECT_SET, &offset, NULL, &count, NULL) < 0)
+            goto error;
 
-        for (uint32_t v = 0; v < CHUNK_SIZE; v++)
-            buf[v] = chunk_n;
+        fill_kernels[type](buf, chunk_n, count);
 
         if (H5Dwrite(did, tid, msid, fsid, H5P_DEFAULT, buf) < 0)
             goto error;
-
-        chunk_n++;
     }
 
     /*********/
@@ -134,12 +169,8 @@ main(int argc, char *argv[])
         goto error;
     if (H5Dclose(did) < 0)
         goto error;
-    if (H5Fclose(fid) < 0)
-        goto error;
 
-    printf("DONE!\n");
-
-    return EXIT_SUCCESS;
+    return 0;
 
 error:
     H5E_BEGIN_TRY {
@@ -151,6 +182,220 @@ error:
         H5Sclose(fsid);
         H5Pclose(dcpl_id);
         H5Dclose(did);
+    } H5E_END_TRY;
+
+    return -1;
+} /* write_dataset */
+
+/* Writes the data to n_sources chunked source files, whole chunks per file,
+ * and maps them into a virtual dataset in fid. The mappings store the source
+ * file names relative to the virtual dataset's file.
+ */
+int
+write_virtual_dataset(hid_t fid, const char *filename, int n_sources, hsize_t dims, hsize_t chunk_size,
+        elem_type_e type)
+{
+    hid_t src_fid = H5I_INVALID_HID;
+    hid_t tid = H5I_INVALID_HID;
+    hid_t dcpl_id = H5I_INVALID_HID;
+    hid_t did = H5I_INVALID_HID;
+    hid_t vsid = H5I_INVALID_HID;
+    hid_t ssid = H5I_INVALID_HID;
+
+    hsize_t nchunks = (dims + chunk_size - 1) / chunk_size;
+    hsize_t first = 0;
+    hsize_t count = 0;
+
+    const char *base = NULL;
+    char *src_name = NULL;
+
+    if (NULL == (src_name = malloc(strlen(filename) + 32)))
+        goto error;
+
+    if (H5I_INVALID_HID == (tid = H5Tcopy(elem_type_native(type))))
+        goto error;
+    if (H5I_INVALID_HID == (vsid = H5Screate_simple(1, &dims, &dims)))
+        goto error;
+    if (H5I_INVALID_HID == (dcpl_id = H5Pcreate(H5P_DATASET_CREATE)))
+        goto error;
+
+    for (int i = 0; i < n_sources; i++) {
+
+        /* Spread the chunks as evenly as possible */
+        first = (nchunks * i / n_sources) * chunk_size;
+        count = (nchunks * (i + 1) / n_sources) * chunk_size;
+        if (count > dims)
+            count = dims;
+        count -= first;
+        if (0 == count)
+            continue;
+
+        sprintf(src_name, "%s.src%d", filename, i);
+
+        if (H5I_INVALID_HID == (src_fid = H5Fcreate(src_name, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT)))
+            goto error;
+        if (write_dataset(src_fid, H5D_CHUNKED, count, chunk_size, type, first) < 0)
+            goto error;
+        if (H5Fclose(src_fid) < 0)
+            goto error;
+        src_fid = H5I_INVALID_HID;
+
+        if (H5I_INVALID_HID == (ssid = H5Screate_simple(1, &count, &count)))
+            goto error;
+        if (H5Sselect_hyperslab(vsid, H5S_SELECT_SET, &first, NULL, &count, NULL) < 0)
+            goto error;
+
+        base = strrchr(src_name, '/') ? strrchr(src_name, '/') + 1 : src_name;
+        if (H5Pset_virtual(dcpl_id, vsid, base, DATASET_NAME, ssid) < 0)
+            goto error;
+
+        if (H5Sclose(ssid) < 0)
+            goto error;
+        ssid = H5I_INVALID_HID;
+    }
+
+    if (H5Sselect_all(vsid) < 0)
+        goto error;
+    if (H5I_INVALID_HID == (did = H5Dcreate2(fid, DATASET_NAME, tid, vsid, H5P_DEFAULT, dcpl_id, H5P_DEFAULT)))
+        goto error;
+
+    if (write_chunk_size_attr(did, chunk_size) < 0)
+        goto error;
+
+    free(src_name);
+
+    if (H5Tclose(tid) < 0)
+        goto error;
+    if (H5Sclose(vsid) < 0)
+        goto error;
+    if (H5Pclose(dcpl_id) < 0)
+        goto error;
+    if (H5Dclose(did) < 0)
+        goto error;
+
+    return 0;
+
+error:
+    H5E_BEGIN_TRY {
+
+        free(src_name);
+
+        H5Fclose(src_fid);
+        H5Tclose(tid);
+        H5Sclose(vsid);
+        H5Sclose(ssid);
+        H5Pclose(dcpl_id);
+        H5Dclose(did);
+    } H5E_END_TRY;
+
+    return -1;
+} /* write_virtual_dataset */
+
+int
+main(int argc, char *argv[])
+{
+    hid_t fid = H5I_INVALID_HID;
+
+    int c;
+
+    char *filename = NULL;
+
+    H5D_layout_t layout = H5D_CHUNKED;
+
+    int n_sources = 0;
+
+    hsize_t dims = DSET_SIZE;
+    hsize_t chunk_size = CHUNK_SIZE;
+    elem_type_e type = ELEM_UINT32;
+
+    while ((c = getopt(argc, argv, ":d:c:e:l:v:")) != -1) {
+        switch (c) {
+            case 'd':
+                dims = strtoull(optarg, NULL, 0);
+                break;
+            case 'c':
+                chunk_size = strtoull(optarg, NULL, 0);
+                break;
+            case 'e':
+                if (ELEM_N_TYPES == (type = elem_type_from_name(optarg))) {
+                    printf("\n");
+                    printf("BADNESS: Unknown element type %s\n", optarg);
+                    usage();
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'l':
+                if (!strcmp(optarg, "contiguous"))
+                    layout = H5D_CONTIGUOUS;
+                else if (!strcmp(optarg, "compact"))
+                    layout = H5D_COMPACT;
+                break;
+            case 'v':
+                layout = H5D_VIRTUAL;
+                n_sources = atoi(optarg);
+                break;
+            case '?':
+                usage();
+                exit(EXIT_SUCCESS);
+        }
+    }
+
+    /* File name is the last argument */
+    if (optind != argc - 1) {
+        printf("\n");
+        printf("BADNESS: Data file name must be last parameter\n");
+        printf("\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    else
+        filename = argv[optind];
+
+    if (0 == dims || 0 == chunk_size) {
+        printf("\n");
+        printf("BADNESS: Dataset and chunk sizes must be at least one element\n");
+        printf("\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    if (H5D_VIRTUAL == layout && n_sources < 1) {
+        printf("\n");
+        printf("BADNESS: A virtual dataset needs at least one source file\n");
+        printf("\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    printf("HDF5 multithreaded I/O work-around - generator\n");
+
+    if (H5D_COMPACT == layout)
+        dims = COMPACT_BYTES / elem_type_sizes[type];
+    if (chunk_size > dims)
+        chunk_size = dims;
+
+    printf("Dataset size: %llu elements  Chunk size: %llu elements  Element type: %s\n",
+            (unsigned long long)dims, (unsigned long long)chunk_size, elem_type_names[type]);
+
+    if (H5I_INVALID_HID == (fid = H5Fcreate(filename, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT)))
+        goto error;
+
+    if (H5D_VIRTUAL == layout) {
+        if (write_virtual_dataset(fid, filename, n_sources, dims, chunk_size, type) < 0)
+            goto error;
+    }
+    else if (write_dataset(fid, layout, dims, chunk_size, type, 0) < 0)
+        goto error;
+
+    if (H5Fclose(fid) < 0)
+        goto error;
+
+    printf("DONE!\n");
+
+    return EXIT_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
         H5Fclose(fid);
     } H5E_END_TRY;
 
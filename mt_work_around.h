@@ -3,8 +3,17 @@
 #ifndef _mt_work_around_H
 #define _mt_work_around_H
 
+#include <string.h>
+
+#include <hdf5.h>
+
 #define DATASET_NAME "data"
 
+/* Attribute holding the number of elements in each block of the generated
+ * pattern, for layouts where that can't be read from the chunk dimensions
+ */
+#define CHUNK_SIZE_ATTR_NAME "chunk_size"
+
 /* 1 TiB = 1,099,511,627,776 bytes
  * @32 bits per element: 274,877,906,944 elements
  * @64 bits per element: 68,719,476,736 elements
@@ -14,14 +23,101 @@
  * 1,073,741,824 elements @ 32 bits per element = 4,294,967,296 bytes (4 GiB)
  */
 
-/* 1D dataset, size in elements */
+/* Default 1D dataset size, in elements (the generator's -d option) */
 //#define DSET_SIZE        274877906944       /* 1 TiB for 32-bit datatypes */
 //#define DSET_SIZE        68719476736        /* 1 TiB for 64-bit datatypes, 512 GiB for 32-bit */
 //#define DSET_SIZE        4294967296         /* 16 GiB file for smaller systems */
 #define DSET_SIZE        1073741824         /* 4 GiB file for testing */
 
-/* Chunk size, in elements (set low to force a lot of thread activity) */
+/* Default chunk size, in elements (set low to force a lot of thread activity)
+ * (the generator's -c option)
+ */
 #define CHUNK_SIZE  1048576
 
-#endif /* _mt_work_around_H */
+/* Compact datasets are stored in the object header, which is limited
+ * to 64 KiB, so they get their own (small) size, in bytes.
+ */
+#define COMPACT_BYTES   32768
+
+/* Element types the generator can write and the reader can verify */
+typedef enum elem_type_e {
+    ELEM_UINT8 = 0,
+    ELEM_UINT16,
+    ELEM_UINT32,
+    ELEM_UINT64,
+    ELEM_FLOAT,
+    ELEM_DOUBLE,
+    ELEM_N_TYPES
+} elem_type_e;
+
+static const char *const elem_type_names[ELEM_N_TYPES] = {
+    "uint8", "uint16", "uint32", "uint64", "float", "double"
+};
+
+static const size_t elem_type_sizes[ELEM_N_TYPES] = {
+    sizeof(uint8_t), sizeof(uint16_t), sizeof(uint32_t), sizeof(uint64_t), sizeof(float), sizeof(double)
+};
 
+/* Returns ELEM_N_TYPES if the name isn't recognized */
+static inline elem_type_e
+elem_type_from_name(const char *name)
+{
+    int i;
+
+    for (i = 0; i < ELEM_N_TYPES; i++)
+        if (!strcmp(name, elem_type_names[i]))
+            break;
+
+    return (elem_type_e)i;
+}
+
+/* The H5T_NATIVE_* types are not constants, so this can't be a table */
+static inline hid_t
+elem_type_native(elem_type_e type)
+{
+    switch (type) {
+        case ELEM_UINT8:
+            return H5T_NATIVE_UINT8;
+        case ELEM_UINT16:
+            return H5T_NATIVE_UINT16;
+        case ELEM_UINT32:
+            return H5T_NATIVE_UINT32;
+        case ELEM_UINT64:
+            return H5T_NATIVE_UINT64;
+        case ELEM_FLOAT:
+            return H5T_NATIVE_FLOAT;
+        case ELEM_DOUBLE:
+            return H5T_NATIVE_DOUBLE;
+        default:
+            return H5I_INVALID_HID;
+    }
+}
+
+/* Type-specialized fill kernels, one per element type, used to write the
+ * pattern (every element of a chunk holds the chunk's number)
+ */
+#define DEFINE_FILL_KERNEL(NAME, T)                                 \
+    static void                                                     \
+    fill_##NAME(void *buf, uint64_t val, hsize_t count)             \
+    {                                                               \
+        T *b = (T *)buf;                                            \
+        const T v = (T)val;                                         \
+                                                                    \
+        for (hsize_t i = 0; i < count; i++)                         \
+            b[i] = v;                                               \
+    }
+
+DEFINE_FILL_KERNEL(uint8, uint8_t)
+DEFINE_FILL_KERNEL(uint16, uint16_t)
+DEFINE_FILL_KERNEL(uint32, uint32_t)
+DEFINE_FILL_KERNEL(uint64, uint64_t)
+DEFINE_FILL_KERNEL(float, float)
+DEFINE_FILL_KERNEL(double, double)
+
+typedef void (*fill_kernel_t)(void *buf, uint64_t val, hsize_t count);
+
+static const fill_kernel_t fill_kernels[ELEM_N_TYPES] = {
+    fill_uint8, fill_uint16, fill_uint32, fill_uint64, fill_float, fill_double
+};
+
+#endif /* _mt_work_around_H */
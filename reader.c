@@ -1,13 +1,23 @@
 /* Reader program for HDF5 multithreaded dataset I/O work-around example */
 
+/* For preadv2(2) */
+#define _GNU_SOURCE
+
 #include <assert.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+#endif
+
 #include <hdf5.h>
 
 #include "thpool.h"
@@ -18,7 +28,11 @@ typedef enum algorithm_e {
     HDF5_DEFAULT = 0,
     DIRECT_CHUNK,
     POSIX_ST,
-    POSIX_MT
+    POSIX_MT,
+    POSIX_SAMPLE,
+    POSIX_MULTI,
+    POSIX_UPDATE,
+    POSIX_SCAN
 } algorithm_e;
 
 
@@ -33,6 +47,12 @@ bool show_thread_times_g = false;
 /* Whether or not to show thread bandwidths */
 bool show_thread_bandwidths_g = false;
 
+/* Dataset geometry and element type, read from the file */
+hsize_t dset_size_g = 0;            /* In elements */
+hsize_t chunk_size_g = 0;           /* In elements, also the generator's pattern block */
+elem_type_e elem_type_g = ELEM_UINT32;
+size_t elem_size_g = sizeof(uint32_t);
+
 /* Function to convert timespec struct to nanoseconds */
 uint64_t
 ns_from_timespec(struct timespec ts)
@@ -130,49 +150,158 @@ print_bandwidth(uint64_t n_bytes, struct timespec start_ts, struct timespec end_
 
 } /* print_bandwidth() */
 
+/* Type-specialized verify kernels, one per element type. Each returns the
+ * index of the first element that isn't val, or count if they all are.
+ * They're picked once per call so the loop itself is fully typed.
+ */
+#define DEFINE_VERIFY_KERNEL(NAME, T, FMT, PRINT_T)                                     \
+    hsize_t                                                                             \
+    verify_##NAME(const void *buf, uint64_t val, hsize_t count)                         \
+    {                                                                                   \
+        const T *b = (const T *)buf;                                                    \
+        const T v = (T)val;                                                             \
+                                                                                        \
+        for (hsize_t i = 0; i < count; i++)                                             \
+            if (b[i] != v)                                                              \
+                return i;                                                               \
+                                                                                        \
+        return count;                                                                   \
+    }                                                                                   \
+                                                                                        \
+    void                                                                                \
+    print_mismatch_##NAME(const void *buf, uint64_t val, hsize_t i, hsize_t index)      \
+    {                                                                                   \
+        printf("BAD VERIFICATION! " FMT " should be " FMT " at index %llu\n",           \
+                (PRINT_T)((const T *)buf)[i], (PRINT_T)(T)val, index);                  \
+    }
+
+DEFINE_VERIFY_KERNEL(uint8, uint8_t, "%llu", unsigned long long)
+DEFINE_VERIFY_KERNEL(uint16, uint16_t, "%llu", unsigned long long)
+DEFINE_VERIFY_KERNEL(uint32, uint32_t, "%llu", unsigned long long)
+DEFINE_VERIFY_KERNEL(uint64, uint64_t, "%llu", unsigned long long)
+DEFINE_VERIFY_KERNEL(float, float, "%.9g", double)
+DEFINE_VERIFY_KERNEL(double, double, "%.17g", double)
+
+typedef hsize_t (*verify_kernel_t)(const void *buf, uint64_t val, hsize_t count);
+typedef void (*print_mismatch_t)(const void *buf, uint64_t val, hsize_t i, hsize_t index);
+
+verify_kernel_t verify_kernels[ELEM_N_TYPES] = {
+    verify_uint8, verify_uint16, verify_uint32, verify_uint64, verify_float, verify_double
+};
+
+print_mismatch_t print_mismatches[ELEM_N_TYPES] = {
+    print_mismatch_uint8, print_mismatch_uint16, print_mismatch_uint32,
+    print_mismatch_uint64, print_mismatch_float, print_mismatch_double
+};
+
+/* Checks that count elements of the given type are all val. Mismatches are
+ * reported at base_index plus their position in buf.
+ */
 int
-verify(uint32_t *buf, uint32_t val, int count)
+verify_typed(const void *buf, elem_type_e type, uint64_t val, hsize_t count, hsize_t base_index)
 {
+    hsize_t i;
+
     assert(buf);
 
-    for (int i = 0; i < count; i++)
-        if (buf[i] != val) {
-            printf("BAD VERIFICATION! %ul should be %ul at index %d\n", buf[i], val, i);
-            return -1;
-        }
+    if ((i = verify_kernels[type](buf, val, count)) < count) {
+        print_mismatches[type](buf, val, i, base_index + i);
+        return -1;
+    }
 
     return 0;
+} /* verify_typed */
+
+int
+verify(const void *buf, uint64_t val, hsize_t count)
+{
+    return verify_typed(buf, elem_type_g, val, count, 0);
 } /* verify */
 
+/* Number of elements of chunk chunk_n that are inside the dataset. Only
+ * the last chunk can come up short.
+ */
+hsize_t
+chunk_elements(hsize_t chunk_n)
+{
+    hsize_t first = chunk_n * chunk_size_g;
+
+    return (dset_size_g - first < chunk_size_g) ? dset_size_g - first : chunk_size_g;
+} /* chunk_elements */
+
+/* Maps a dataset's datatype to one of the element types, or returns
+ * ELEM_N_TYPES if it isn't one of them
+ */
+elem_type_e
+elem_type_of(hid_t did)
+{
+    hid_t tid = H5I_INVALID_HID;
+    H5T_class_t cls;
+    size_t size;
+    H5T_sign_t sign;
+    elem_type_e type = ELEM_N_TYPES;
+
+    if (H5I_INVALID_HID == (tid = H5Dget_type(did)))
+        return ELEM_N_TYPES;
+
+    cls = H5Tget_class(tid);
+    size = H5Tget_size(tid);
+    sign = H5Tget_sign(tid);
+
+    if (H5T_INTEGER == cls && H5T_SGN_NONE == sign) {
+        if (1 == size)
+            type = ELEM_UINT8;
+        else if (2 == size)
+            type = ELEM_UINT16;
+        else if (4 == size)
+            type = ELEM_UINT32;
+        else if (8 == size)
+            type = ELEM_UINT64;
+    }
+    else if (H5T_FLOAT == cls) {
+        if (sizeof(float) == size)
+            type = ELEM_FLOAT;
+        else if (sizeof(double) == size)
+            type = ELEM_DOUBLE;
+    }
+
+    H5Tclose(tid);
+
+    return type;
+} /* elem_type_of */
+
 int
 hdf5_default(hid_t did, hid_t tid, hid_t msid, hid_t fsid)
 {
     hsize_t offset = 0;
     hsize_t count = 0;
     uint32_t chunk_n = 0;
-    uint32_t *buf = NULL;
+    void *buf = NULL;
 
     printf("H5Dread I/O calls\n");
 
-    if (NULL == (buf = malloc(CHUNK_SIZE * sizeof(uint32_t))))
+    if (NULL == (buf = malloc(chunk_size_g * elem_size_g)))
         goto error;
 
-    count = CHUNK_SIZE;
     chunk_n = 0;
 
-    for (hsize_t u = 0; u < DSET_SIZE; u += CHUNK_SIZE) {
+    for (hsize_t u = 0; u < dset_size_g; u += chunk_size_g) {
 
         offset = u;
+        count = chunk_elements(chunk_n);
 
-        memset(buf, 0, CHUNK_SIZE * sizeof(uint32_t));
+        memset(buf, 0, chunk_size_g * elem_size_g);
 
         if (H5Sselect_hyperslab(fsid, H5S_SELECT_SET, &offset, NULL, &count, NULL) < 0)
             goto error;
+        offset = 0;
+        if (H5Sselect_hyperslab(msid, H5S_SELECT_SET, &offset, NULL, &count, NULL) < 0)
+            goto error;
 
         if (H5Dread(did, tid, msid, fsid, H5P_DEFAULT, buf) < 0)
             goto error;
 
-        if (verify(buf, chunk_n, CHUNK_SIZE) < 0)
+        if (verify(buf, chunk_n, count) < 0)
             goto error;
 
         chunk_n++;
@@ -194,25 +323,25 @@ direct_chunk(hid_t did)
     hsize_t offset = 0;
     uint32_t mask = 0;
     uint32_t chunk_n = 0;
-    uint32_t *buf = NULL;
+    void *buf = NULL;
 
     printf("H5Dread_chunk I/O calls\n");
 
-    if (NULL == (buf = malloc(CHUNK_SIZE * sizeof(uint32_t))))
+    if (NULL == (buf = malloc(chunk_size_g * elem_size_g)))
         goto error;
 
     chunk_n = 0;
 
-    for (hsize_t u = 0; u < DSET_SIZE; u += CHUNK_SIZE) {
+    for (hsize_t u = 0; u < dset_size_g; u += chunk_size_g) {
 
         offset = u;
 
-        memset(buf, 0, CHUNK_SIZE * sizeof(uint32_t));
+        memset(buf, 0, chunk_size_g * elem_size_g);
 
         if (H5Dread_chunk(did, H5P_DEFAULT, &offset, &mask, buf) < 0)
             goto error;
 
-        if (verify(buf, chunk_n, CHUNK_SIZE) < 0)
+        if (verify(buf, chunk_n, chunk_elements(chunk_n)) < 0)
             goto error;
 
         chunk_n++;
@@ -240,7 +369,7 @@ posix_single_thread(hid_t did, hid_t fsid, const char *filename)
     int fd = -1;
 
     uint32_t chunk_n = 0;
-    uint32_t *buf = NULL;
+    void *buf = NULL;
 
     printf("Single-threaded POSIX I/O calls\n");
 
@@ -248,7 +377,7 @@ posix_single_thread(hid_t did, hid_t fsid, const char *filename)
     if ((fd = open(filename, O_RDONLY)) < 0)
         goto error;
 
-    if (NULL == (buf = malloc(CHUNK_SIZE * sizeof(int))))
+    if (NULL == (buf = malloc(chunk_size_g * elem_size_g)))
         goto error;
 
     /* Get the number of chunks */
@@ -261,9 +390,9 @@ posix_single_thread(hid_t did, hid_t fsid, const char *filename)
 
     for (hsize_t u = 0; u < nchunks; u++) {
 
-        offset = u * CHUNK_SIZE;
+        offset = u * chunk_size_g;
 
-        memset(buf, 0, CHUNK_SIZE * sizeof(uint32_t));
+        memset(buf, 0, chunk_size_g * elem_size_g);
 
         /* Get the chunk size */
         addr = HADDR_UNDEF;
@@ -275,7 +404,7 @@ posix_single_thread(hid_t did, hid_t fsid, const char *filename)
         if (pread(fd, buf, size, (off_t)addr) < 0)
             goto error;
 
-        if (verify(buf, chunk_n, CHUNK_SIZE) < 0)
+        if (verify(buf, chunk_n, chunk_elements(chunk_n)) < 0)
             goto error;
 
         chunk_n++;
@@ -312,21 +441,21 @@ read_and_verify(void *arg)
     struct timespec thread_start_ts;
     struct timespec thread_end_ts;
 
-    uint32_t *buf = NULL;
+    void *buf = NULL;
 
     /* START THREAD TIMER */
     if (show_thread_times_g || show_thread_bandwidths_g)
         if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_start_ts) < 0)
             goto error;
 
-    if (NULL == (buf = malloc(CHUNK_SIZE * sizeof(uint32_t))))
+    if (NULL == (buf = malloc(chunk_size_g * elem_size_g)))
         goto error;
 
     /* Read the data */
     if (pread(fd_g, buf, params->size, (off_t)(params->addr)) < 0)
         goto error;
 
-    if (verify(buf, params->chunk_n, CHUNK_SIZE) < 0)
+    if (verify(buf, params->chunk_n, chunk_elements(params->chunk_n)) < 0)
         goto error;
 
     free(buf);
@@ -351,8 +480,67 @@ error:
 }
 
 
+/* Page cache fast path
+ *
+ * With -w, each chunk is first read on the main thread with
+ * preadv2(RWF_NOWAIT), which only succeeds if the data is already in the
+ * page cache. Hits are verified inline, so they never queue behind chunks
+ * that have to wait on the disk. Misses are collected into batches of
+ * NOWAIT_BATCH_PER_THREAD per thread, sorted by file address, and handed to
+ * the thread pool.
+ */
+
+#define NOWAIT_BATCH_PER_THREAD 4
+
+/* Returns 1 if the whole chunk came from the page cache, 0 if it has to
+ * go to the disk, and -1 if RWF_NOWAIT isn't supported here.
+ */
+int
+try_cached_read(void *buf, hsize_t size, haddr_t addr)
+{
+#ifdef RWF_NOWAIT
+    struct iovec iov;
+    ssize_t ret;
+
+    iov.iov_base = buf;
+    iov.iov_len = size;
+
+    if ((ret = preadv2(fd_g, &iov, 1, (off_t)addr, RWF_NOWAIT)) == (ssize_t)size)
+        return 1;
+    if (ret < 0 && (EOPNOTSUPP == errno || ENOSYS == errno || EINVAL == errno))
+        return -1;
+
+    /* EAGAIN, or only part of the chunk is cached */
+    return 0;
+#else
+    return -1;
+#endif
+} /* try_cached_read */
+
+int
+compare_work_addr(const void *a, const void *b)
+{
+    haddr_t x = (*(const work_params_t * const *)a)->addr;
+    haddr_t y = (*(const work_params_t * const *)b)->addr;
+
+    return (x > y) - (x < y);
+}
+
+/* Sorts a batch of cache misses by address and queues them */
+int
+launch_misses(threadpool pool, work_params_t **misses, size_t n_misses)
+{
+    qsort(misses, n_misses, sizeof(work_params_t *), compare_work_addr);
+
+    for (size_t u = 0; u < n_misses; u++)
+        if (thpool_add_work(pool, read_and_verify, (void *)misses[u]) < 0)
+            return -1;
+
+    return 0;
+} /* launch_misses */
+
 int
-posix_multithreaded(hid_t did, hid_t fsid, const char *filename, int n_threads)
+posix_multithreaded(hid_t did, hid_t fsid, const char *filename, int n_threads, bool nowait)
 {
     hsize_t offset = 0;
     hsize_t nchunks = 0;
@@ -364,6 +552,14 @@ posix_multithreaded(hid_t did, hid_t fsid, const char *filename, int n_threads)
 
     work_params_t *params = NULL;
 
+    work_params_t **misses = NULL;
+    size_t n_misses = 0;
+    size_t max_misses = (size_t)n_threads * NOWAIT_BATCH_PER_THREAD;
+    void *buf = NULL;
+    hsize_t n_hits = 0;
+    hsize_t n_total_misses = 0;
+    int hit;
+
     threadpool pool = NULL;
 
     printf("Multithreaded POSIX I/O calls\n");
@@ -391,6 +587,13 @@ posix_multithreaded(hid_t did, hid_t fsid, const char *filename, int n_threads)
     if (NULL == (params = calloc(nchunks, sizeof(work_params_t))))
         goto error;
 
+    if (nowait) {
+        if (NULL == (misses = malloc(max_misses * sizeof(work_params_t *))))
+            goto error;
+        if (NULL == (buf = malloc(chunk_size_g * elem_size_g)))
+            goto error;
+    }
+
     /* Loop over all chunks */
 
     chunk_n = 0;
@@ -399,7 +602,7 @@ posix_multithreaded(hid_t did, hid_t fsid, const char *filename, int n_threads)
         goto error;
     for (hsize_t u = 0; u < nchunks; u++) {
 
-        offset = u * CHUNK_SIZE;
+        offset = u * chunk_size_g;
 
         /* Get the chunk size */
         if (H5Dget_chunk_info_by_coord(did, &offset, &mask, &(params[u].addr), &(params[u].size)) < 0)
@@ -407,17 +610,47 @@ posix_multithreaded(hid_t did, hid_t fsid, const char *filename, int n_threads)
 
         params[u].chunk_n = chunk_n;
 
+        chunk_n++;
+
+        /* Cache hits are done here and now, misses wait for a full batch */
+        if (nowait) {
+            if ((hit = try_cached_read(buf, params[u].size, params[u].addr)) < 0) {
+                printf("RWF_NOWAIT is not supported, sending all chunks to the thread pool\n");
+                nowait = false;
+            }
+            else if (hit) {
+                if (verify(buf, params[u].chunk_n, chunk_elements(params[u].chunk_n)) < 0)
+                    goto error;
+                n_hits++;
+                continue;
+            }
+            else {
+                misses[n_misses++] = &params[u];
+                n_total_misses++;
+                if (n_misses == max_misses) {
+                    if (launch_misses(pool, misses, n_misses) < 0)
+                        goto error;
+                    n_misses = 0;
+                }
+                continue;
+            }
+        }
+
         /* Add a unit of work to the thread pool */
         if (thpool_add_work(pool, read_and_verify, (void *)&params[u]) < 0)
             goto error;
-
-        chunk_n++;
     }
+    if (n_misses > 0)
+        if (launch_misses(pool, misses, n_misses) < 0)
+            goto error;
     if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
         goto error;
     print_elapsed_sec(start_ts, end_ts);
     printf("\tTime spent launching threads (via CLOCK_MONOTONIC)\n");
 
+    if (misses)
+        printf("Page cache hits: %llu  misses: %llu\n", n_hits, n_total_misses);
+
     if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
         goto error;
     thpool_wait(pool);
@@ -438,6 +671,8 @@ posix_multithreaded(hid_t did, hid_t fsid, const char *filename, int n_threads)
     printf("\tTime to destroy thread pool (via CLOCK_MONOTONIC)\n");
 
     free(params);
+    free(misses);
+    free(buf);
 
     return 0;
 
@@ -450,213 +685,2892 @@ error:
         thpool_destroy(pool); 
 
     free(params);
+    free(misses);
+    free(buf);
 
     return -1;
 } /* posix_multithreaded */
 
+/* Contiguous and compact layouts
+ *
+ * A contiguous dataset is one run of bytes in the file, so there is nothing
+ * to look up per chunk. The base address is fetched once and the byte range
+ * is split into segments that are read and verified by the thread pool.
+ * A compact dataset lives in the object header and is already in memory once
+ * the dataset is open, so it is read with a single H5Dread.
+ */
 
-void
-usage(void)
-{
-    printf("\n");
-    printf("HDF5 multi-threaded I/O work-around - reader\n");
-    printf("Reads and verifies the data in the generated file.\n");
-    printf("(Run after running the generator program)\n");
-    printf("\n");
-    printf("The four algorithms are:\n");
-    printf("\n");
-    printf("default - Uses H5Dread to read the data.\n");
-    printf("          This is the default so you don't need to specify this explicitly.\n");
-    printf("\n");
-    printf("directchunk - Uses H5Dread_chunk to read the data.\n");
-    printf("              This bypasses the filter pipeline and can be\n");
-    printf("              slightly more efficient (albeit dangerous).\n");
-    printf("\n");
-    printf("posixst - Uses pread(2) to read the data outside of the HDF5 library.\n");
-    printf("          This is mainly a sanity check on the multithreaded algorithm.\n");
-    printf("\n");
-    printf("posixmt - Uses pread(2) to read the data outside of the HDF5 library\n");
-    printf("          using multiple threads, the number of which can be set using\n");
-    printf("          the -t parameter.\n");
-    printf("\n");
-    printf("Usage: reader [options] <filename> \n");
-    printf("\n");
-    printf("Options:\n");
-    printf("\ta\tI/O algorithm (default|directchunk|posixst|posixmt)\n");
-    printf("\nb\tShow thread bandwidth (default: no)\n");
-    printf("\tn\tNumber of threads in thread pool (posixmt only, default is 4)\n");
-    printf("\nt\tShow thread execution times (default: no)\n");
-    printf("\t?\tPrint this help information\n");
-    printf("\n");
-} /* usage */
+typedef struct segment_params_t {
+    haddr_t addr;
+    hsize_t size;
+    hsize_t first_element;
+} segment_params_t;
 
+/* Like verify(), but for a run of elements that can straddle the
+ * chunk_size_g-element blocks the generator writes. Each block is handed
+ * to the verify kernel whole.
+ */
 int
-main(int argc, char *argv[])
+verify_range(const void *buf, hsize_t first_element, hsize_t count)
 {
-    hid_t fid = H5I_INVALID_HID;
-    hid_t tid = H5I_INVALID_HID;
-    hid_t did = H5I_INVALID_HID;
-    hid_t msid = H5I_INVALID_HID;
-    hid_t fsid = H5I_INVALID_HID;
+    hsize_t i = 0;
+    hsize_t run;
 
-    hsize_t dims = DSET_SIZE;
-    hsize_t chunk_dims = CHUNK_SIZE;
+    assert(buf);
 
-    struct timespec ts;
-    struct timespec process_start_ts;
-    struct timespec process_end_ts;
+    while (i < count) {
+        hsize_t element = first_element + i;
 
-    int c;
+        run = chunk_size_g - (element % chunk_size_g);
+        if (run > count - i)
+            run = count - i;
 
-    algorithm_e algorithm = HDF5_DEFAULT;
+        if (verify_typed((const char *)buf + (i * elem_size_g), elem_type_g, element / chunk_size_g, run,
+                    element) < 0)
+            return -1;
 
-    int n_threads = 4;
+        i += run;
+    }
 
-    char *filename = NULL;
+    return 0;
+} /* verify_range */
 
-    while ((c = getopt(argc, argv, ":a:bn:t")) != -1) {
-        switch (c) {
-            case 'a':
-                if (!strcmp(optarg, "directchunk"))
-                    algorithm = DIRECT_CHUNK;
-                else if (!strcmp(optarg, "posixst"))
-                    algorithm = POSIX_ST;
-                else if (!strcmp(optarg, "posixmt"))
-                    algorithm = POSIX_MT;
-                break;
-            case 'b':
-                show_thread_bandwidths_g = true;
-                break;
-            case 'n':
-                n_threads = atoi(optarg);
-                break;
-            case 't':
-                show_thread_times_g = true;
-                break;
-            case '?':
-                usage();
-                exit(EXIT_SUCCESS);
-        }
-    }
+void
+read_and_verify_segment(void *arg)
+{
+    segment_params_t *params = (segment_params_t *)arg;
 
-    /* File name is the last argument */
-    if (optind != argc - 1) {
-        printf("\n");
-        printf("BADNESS: Data file name must be last parameter\n");
-        printf("\n");
-        usage();
-        exit(EXIT_FAILURE);
-    }
-    else
-        filename = argv[optind];
+    struct timespec thread_start_ts;
+    struct timespec thread_end_ts;
 
-    printf("HDF5 multithreaded I/O work-around - reader\n");
+    void *buf = NULL;
 
-    /* Spit out the clock resolutions */
-    printf("\n");
-    printf("Resolution of clocks as reported by clock_getres(3)\n");
-    if (clock_getres(CLOCK_MONOTONIC, &ts) < 0)
-        goto error;
-    printf("%-32s", "CLOCK_MONOTONIC: ");
-    printf("%lld.%.9ld s\n", (long long)ts.tv_sec, ts.tv_nsec);
+    /* START THREAD TIMER */
+    if (show_thread_times_g || show_thread_bandwidths_g)
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_start_ts) < 0)
+            goto error;
 
-    if (clock_getres(CLOCK_PROCESS_CPUTIME_ID, &ts) < 0)
+    if (NULL == (buf = malloc(params->size)))
         goto error;
-    printf("%-32s", "CLOCK_PROCESS_CPUTIME_ID: ");
-    printf("%lld.%.9ld s\n", (long long)ts.tv_sec, ts.tv_nsec);
 
-    if (clock_getres(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+    /* Read the data */
+    if (pread(fd_g, buf, params->size, (off_t)(params->addr)) != (ssize_t)params->size)
         goto error;
-    printf("%-32s", "CLOCK_THREAD_CPUTIME_ID: ");
-    printf("%lld.%.9ld s\n", (long long)ts.tv_sec, ts.tv_nsec);
-    printf("\n");
-
-    /***************************/
-    /* Create/open HDF5 things */
-    /***************************/
 
-    /* START PROCESS TIMER */
-    if (clock_gettime(CLOCK_MONOTONIC, &process_start_ts) < 0)
+    if (verify_range(buf, params->first_element, params->size / elem_size_g) < 0)
         goto error;
 
-    if (H5I_INVALID_HID == (fid = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT)))
-        goto error;
+    free(buf);
 
-    if (H5I_INVALID_HID == (tid = H5Tcopy(H5T_NATIVE_UINT32)))
-        goto error;
+    /* STOP THREAD TIMER */
+    if (show_thread_times_g || show_thread_bandwidths_g)
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_end_ts) < 0)
+            goto error;
 
-    if (H5I_INVALID_HID == (fsid = H5Screate_simple(1, &dims, &dims)))
-        goto error;
+    /* Print timing and/or bandwidth */
+    if (show_thread_times_g)
+        print_elapsed_sec_thread(thread_start_ts, thread_end_ts);
+    if (show_thread_bandwidths_g)
+        print_bandwidth(params->size, thread_start_ts, thread_end_ts);
 
-    if (H5I_INVALID_HID == (msid = H5Screate_simple(1, &chunk_dims, &chunk_dims)))
-        goto error;
+    return;
 
-    if (H5I_INVALID_HID == (did = H5Dopen2(fid, DATASET_NAME, H5P_DEFAULT)))
-        goto error;
+error:
+    printf("BADNESS in callback! addr: %lu size: %llu\n", params->addr, params->size);
+    free(buf);
+    return;
+}
 
-    /************************/
-    /* Read and verify data */
-    /************************/
+int
+posix_mt_contiguous(hid_t did, const char *filename, int n_threads, hsize_t segment_size)
+{
+    haddr_t base_addr = HADDR_UNDEF;
+    hsize_t total_size = 0;
+    hsize_t nsegments = 0;
 
-    /* H5Dread */
-    if (HDF5_DEFAULT == algorithm)
-        if (hdf5_default(did, tid, msid, fsid) < 0)
-            goto error;
+    struct timespec start_ts;
+    struct timespec end_ts;
 
-    /* H5Dread_chunk */
-    if (DIRECT_CHUNK == algorithm)
-        if (direct_chunk(did) < 0)
-            goto error;
+    segment_params_t *params = NULL;
 
-    /* Single-threaded version of multithreading work-around
-     *
-     * Mainly a sanity check on the algorithm if something goes wrong
-     * with the multithreaded version.
-     */
-    if (POSIX_ST == algorithm)
-        if (posix_single_thread(did, fsid, filename) < 0)
-            goto error;
+    threadpool pool = NULL;
 
-    /* Multithreading work-around */
-    if (POSIX_MT == algorithm)
-        if (posix_multithreaded(did, fsid, filename, n_threads) < 0)
-            goto error;
+    printf("Multithreaded POSIX I/O calls (contiguous layout)\n");
 
-    /*********/
-    /* Close */
-    /*********/
+    /* Segments must hold whole elements */
+    segment_size -= segment_size % elem_size_g;
+    if (0 == segment_size)
+        segment_size = elem_size_g;
+    printf("Segment size: %llu bytes\n", segment_size);
 
-    if (H5Tclose(tid) < 0)
-        goto error;
-    if (H5Sclose(msid) < 0)
+    /* Create the thread pool */
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
         goto error;
-    if (H5Sclose(fsid) < 0)
+    if (NULL == (pool = thpool_init(n_threads)))
         goto error;
-    if (H5Dclose(did) < 0)
+    printf("Number of threads: %d\n", n_threads);
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
         goto error;
-    if (H5Fclose(fid) < 0)
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime to start thread pool (via CLOCK_MONOTONIC)\n");
+
+    /* Open the HDF5 file for POSIX I/O */
+    if ((fd_g = open(filename, O_RDONLY)) < 0)
         goto error;
 
-    /* STOP PROCESS TIMER */
-    if (clock_gettime(CLOCK_MONOTONIC, &process_end_ts) < 0)
+    /* Get the base address once. Unallocated storage and external
+     * files both report HADDR_UNDEF.
+     */
+    if (HADDR_UNDEF == (base_addr = H5Dget_offset(did)))
         goto error;
+    total_size = H5Dget_storage_size(did);
 
-    print_elapsed_sec(process_start_ts, process_end_ts);
-    printf("\tProcess execution time (via CLOCK_MONOTONIC)\n");
+    nsegments = (total_size + segment_size - 1) / segment_size;
 
-    printf("DONE!\n");
+    /* Allocate a giant array to hold callback parameters */
+    if (NULL == (params = calloc(nsegments, sizeof(segment_params_t))))
+        goto error;
 
-    return EXIT_SUCCESS;
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    for (hsize_t u = 0; u < nsegments; u++) {
 
-error:
-    H5E_BEGIN_TRY {
+        params[u].addr = base_addr + (u * segment_size);
+        params[u].size = (u == nsegments - 1) ? total_size - (u * segment_size) : segment_size;
+        params[u].first_element = (u * segment_size) / elem_size_g;
+
+        /* Add a unit of work to the thread pool */
+        if (thpool_add_work(pool, read_and_verify_segment, (void *)&params[u]) < 0)
+            goto error;
+    }
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent launching threads (via CLOCK_MONOTONIC)\n");
+
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    thpool_wait(pool);
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent waiting for all threads to finish (via CLOCK_MONOTONIC)\n");
+
+    if (close(fd_g) < 0)
+        goto error;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    thpool_destroy(pool);
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime to destroy thread pool (via CLOCK_MONOTONIC)\n");
+
+    free(params);
+
+    return 0;
+
+error:
+
+    if (fd_g > -1)
+        close(fd_g);
+
+    if (pool)
+        thpool_destroy(pool);
+
+    free(params);
+
+    return -1;
+} /* posix_mt_contiguous */
+
+int
+compact_read(hid_t did)
+{
+    hid_t sid = H5I_INVALID_HID;
+    hssize_t n_elements = 0;
+    void *buf = NULL;
+
+    printf("In-memory read (compact layout)\n");
+
+    if (H5I_INVALID_HID == (sid = H5Dget_space(did)))
+        goto error;
+    if ((n_elements = H5Sget_simple_extent_npoints(sid)) < 0)
+        goto error;
+
+    if (NULL == (buf = malloc(n_elements * elem_size_g)))
+        goto error;
+
+    /* The raw data came in with the object header, so this is a memcpy */
+    if (H5Dread(did, elem_type_native(elem_type_g), H5S_ALL, H5S_ALL, H5P_DEFAULT, buf) < 0)
+        goto error;
+
+    if (verify_range(buf, 0, n_elements) < 0)
+        goto error;
+
+    free(buf);
+
+    if (H5Sclose(sid) < 0)
+        goto error;
+
+    return 0;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Sclose(sid);
+    } H5E_END_TRY;
+
+    free(buf);
+
+    return -1;
+} /* compact_read */
+
+/* Adaptive concurrency
+ *
+ * Instead of queueing every chunk up front, the main thread keeps a limited
+ * number of reads in flight and merges runs of adjacent chunks into larger
+ * preads. Both knobs are tuned while the data is being read: every
+ * AUTO_WINDOW_NS the completed-bytes throughput and mean read latency of the
+ * window are fed to a hill climber. The number of reads in flight grows by
+ * doubling (slow start) and then additively, backing off when throughput
+ * drops or latency rises without a throughput gain. The request size is then
+ * climbed the same way. Once both knobs stop paying off the controller holds
+ * its settings, and starts over if throughput later falls off a cliff.
+ */
+
+/* Length of a measurement window */
+#define AUTO_WINDOW_NS          (20 * 1000 * 1000)
+
+/* Changes smaller than this fraction are treated as noise */
+#define AUTO_EPSILON            0.05
+
+/* A settled controller re-tunes if throughput drops by this fraction */
+#define AUTO_RETUNE_FRACTION    0.25
+
+/* Largest coalesced read */
+#define AUTO_MAX_REQUEST_SIZE   (64 * 1024 * 1024)
+
+/* Ceiling on reads in flight when -n isn't given, the top of batch_timings.sh's sweep */
+#define AUTO_MAX_THREADS        64
+
+typedef enum tune_phase_e {
+    TUNE_DEPTH = 0,
+    TUNE_SIZE,
+    TUNE_SETTLED
+} tune_phase_e;
+
+typedef struct auto_stats_t {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    int in_flight;
+    bool failed;
+
+    uint64_t bytes_done;
+    uint64_t latency_ns;
+    uint64_t n_done;
+} auto_stats_t;
+
+typedef struct auto_params_t {
+    auto_stats_t *stats;
+    uint32_t chunk_n;           /* First chunk in the request */
+    uint32_t n_chunks;
+    haddr_t addr;
+    hsize_t size;
+    struct timespec issue_ts;
+} auto_params_t;
+
+typedef struct auto_controller_t {
+    tune_phase_e phase;
+    bool slow_start;
+
+    int depth;
+    int max_depth;
+    int coalesce;
+    int max_coalesce;
+
+    /* Settings that produced the best throughput so far */
+    int good_depth;
+    int good_coalesce;
+    double best_tput;
+    double last_latency;
+
+    int n_retunes;              /* Times throughput fell after settling */
+} auto_controller_t;
+
+void
+read_and_verify_auto(void *arg)
+{
+    auto_params_t *params = (auto_params_t *)arg;
+    auto_stats_t *stats = params->stats;
+
+    struct timespec end_ts;
+
+    void *buf = NULL;
+    hsize_t n_read = 0;
+    ssize_t ret;
+    bool failed = false;
+
+    if (NULL == (buf = malloc(params->size)))
+        goto error;
+
+    /* Read the data (coalesced reads can be large enough to come back short) */
+    while (n_read < params->size) {
+        if ((ret = pread(fd_g, (char *)buf + n_read, params->size - n_read, (off_t)(params->addr + n_read))) <= 0)
+            goto error;
+        n_read += ret;
+    }
+
+    for (uint32_t u = 0; u < params->n_chunks; u++)
+        if (verify((char *)buf + (u * chunk_size_g * elem_size_g), params->chunk_n + u,
+                    chunk_elements(params->chunk_n + u)) < 0)
+            goto error;
+
+    goto done;
+
+error:
+    printf("BADNESS in callback! addr: %lu size: %llu\n", params->addr, params->size);
+    failed = true;
+
+done:
+    free(buf);
+
+    clock_gettime(CLOCK_MONOTONIC, &end_ts);
+
+    pthread_mutex_lock(&stats->mutex);
+    if (failed)
+        stats->failed = true;
+    stats->bytes_done += params->size;
+    stats->latency_ns += ns_from_timespec(end_ts) - ns_from_timespec(params->issue_ts);
+    stats->n_done++;
+    stats->in_flight--;
+    pthread_cond_signal(&stats->cond);
+    pthread_mutex_unlock(&stats->mutex);
+}
+
+/* Feeds one window's measurements to the controller, which may change
+ * ctl->depth and ctl->coalesce. Decisions are logged.
+ */
+void
+auto_step(auto_controller_t *ctl, double elapsed, double tput, double latency)
+{
+    const char *knob = (TUNE_DEPTH == ctl->phase) ? "depth" : "size";
+    bool improved = tput > ctl->best_tput * (1.0 + AUTO_EPSILON);
+    bool worse = tput < ctl->best_tput * (1.0 - AUTO_EPSILON);
+    /* Bigger requests take longer by design, so only latency growth from
+     * adding depth counts as queueing
+     */
+    bool queueing = TUNE_DEPTH == ctl->phase && !improved && latency > ctl->last_latency * (1.0 + AUTO_EPSILON);
+
+    ctl->last_latency = latency;
+
+    /* Holding steady isn't worth a log line */
+    if (TUNE_SETTLED == ctl->phase && tput >= ctl->best_tput * (1.0 - AUTO_RETUNE_FRACTION))
+        return;
+
+    printf("[auto] %8.3f s  %9.1f MB/s  %8.3f ms  depth %3d  size %4d chunk(s)  ",
+            elapsed, tput / H5_MB, latency * 1000.0, ctl->depth, ctl->coalesce);
+
+    if (TUNE_SETTLED == ctl->phase) {
+        printf("throughput fell, re-tuning\n");
+        ctl->phase = TUNE_DEPTH;
+        ctl->n_retunes++;
+        ctl->best_tput = tput;
+        return;
+    }
+
+    if (improved) {
+        ctl->best_tput = tput;
+        ctl->good_depth = ctl->depth;
+        ctl->good_coalesce = ctl->coalesce;
+
+        if (TUNE_DEPTH == ctl->phase && ctl->depth < ctl->max_depth) {
+            ctl->depth = ctl->slow_start ? ctl->depth * 2 : ctl->depth + 1;
+            if (ctl->depth > ctl->max_depth)
+                ctl->depth = ctl->max_depth;
+            printf("better, %s depth -> %d\n", ctl->slow_start ? "double" : "grow", ctl->depth);
+            return;
+        }
+        if (TUNE_DEPTH != ctl->phase && ctl->coalesce < ctl->max_coalesce) {
+            ctl->coalesce *= 2;
+            if (ctl->coalesce > ctl->max_coalesce)
+                ctl->coalesce = ctl->max_coalesce;
+            printf("better, size -> %d\n", ctl->coalesce);
+            return;
+        }
+        printf("better, %s at its limit, ", knob);
+    }
+    else if (worse || queueing) {
+        /* Back off to the last good setting */
+        ctl->depth = ctl->good_depth;
+        ctl->coalesce = ctl->good_coalesce;
+        printf("%s, back off to depth %d size %d, ", worse ? "worse" : "latency up", ctl->depth, ctl->coalesce);
+    }
+    else
+        printf("flat, keep %s, ", knob);
+
+    ctl->slow_start = false;
+
+    if (TUNE_DEPTH == ctl->phase && ctl->coalesce < ctl->max_coalesce) {
+        ctl->phase = TUNE_SIZE;
+        ctl->coalesce *= 2;
+        if (ctl->coalesce > ctl->max_coalesce)
+            ctl->coalesce = ctl->max_coalesce;
+        printf("try size %d\n", ctl->coalesce);
+    }
+    else {
+        ctl->phase = TUNE_SETTLED;
+        printf("settled\n");
+    }
+} /* auto_step */
+
+int
+posix_mt_auto(hid_t did, hid_t fsid, const char *filename, int max_threads)
+{
+    hsize_t offset = 0;
+    hsize_t nchunks = 0;
+    hsize_t next = 0;
+    hsize_t n_requests = 0;
+    uint32_t mask = 0;
+
+    auto_stats_t stats;
+    auto_controller_t ctl;
+
+    uint64_t window_start_ns = 0;
+    uint64_t window_bytes = 0;
+    uint64_t window_latency_ns = 0;
+    uint64_t window_n_done = 0;
+    uint64_t total_bytes = 0;
+    double settled_at = -1.0;
+
+    struct timespec start_ts;
+    struct timespec end_ts;
+    struct timespec now_ts;
+
+    auto_params_t *params = NULL;
+
+    threadpool pool = NULL;
+
+    printf("Multithreaded POSIX I/O calls (adaptive concurrency)\n");
+
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_init(&stats.mutex, NULL);
+    pthread_cond_init(&stats.cond, NULL);
+
+    memset(&ctl, 0, sizeof(ctl));
+    ctl.phase = TUNE_DEPTH;
+    ctl.slow_start = true;
+    ctl.depth = ctl.good_depth = 1;
+    ctl.coalesce = ctl.good_coalesce = 1;
+    ctl.max_depth = max_threads;
+    ctl.max_coalesce = AUTO_MAX_REQUEST_SIZE / (chunk_size_g * elem_size_g);
+    if (ctl.max_coalesce < 1)
+        ctl.max_coalesce = 1;
+
+    /* Create the thread pool, sized for the most reads we'll have in flight */
+    if (NULL == (pool = thpool_init(max_threads)))
+        goto error;
+    printf("Maximum number of threads: %d\n", max_threads);
+
+    /* Open the HDF5 file for POSIX I/O */
+    if ((fd_g = open(filename, O_RDONLY)) < 0)
+        goto error;
+
+    /* Get the number of chunks */
+    if (H5Dget_num_chunks(did, fsid, &nchunks) < 0)
+        goto error;
+
+    /* One entry per chunk is enough, since a request covers at least one */
+    if (NULL == (params = calloc(nchunks, sizeof(auto_params_t))))
+        goto error;
+
+    /* Build the chunk map up front so the dispatch loop can merge neighbors */
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    for (hsize_t u = 0; u < nchunks; u++) {
+        offset = u * chunk_size_g;
+        if (H5Dget_chunk_info_by_coord(did, &offset, &mask, &(params[u].addr), &(params[u].size)) < 0)
+            goto error;
+        total_bytes += params[u].size;
+    }
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent building the chunk map (via CLOCK_MONOTONIC)\n");
+
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    window_start_ns = ns_from_timespec(start_ts);
+
+    pthread_mutex_lock(&stats.mutex);
+    while (next < nchunks && !stats.failed) {
+        auto_params_t *req = NULL;
+        uint64_t now_ns;
+
+        while (stats.in_flight >= ctl.depth)
+            pthread_cond_wait(&stats.cond, &stats.mutex);
+
+        /* End of a measurement window? */
+        clock_gettime(CLOCK_MONOTONIC, &now_ts);
+        now_ns = ns_from_timespec(now_ts);
+        if (now_ns - window_start_ns >= AUTO_WINDOW_NS && stats.n_done > window_n_done) {
+            double sec = (now_ns - window_start_ns) / 1E9;
+            double tput = (stats.bytes_done - window_bytes) / sec;
+            double latency = (stats.latency_ns - window_latency_ns) / 1E9 / (stats.n_done - window_n_done);
+
+            auto_step(&ctl, (now_ns - ns_from_timespec(start_ts)) / 1E9, tput, latency);
+
+            /* Only the last settle counts, a re-tune starts over */
+            if (TUNE_SETTLED != ctl.phase)
+                settled_at = -1.0;
+            else if (settled_at < 0)
+                settled_at = 100.0 * stats.bytes_done / total_bytes;
+
+            window_start_ns = now_ns;
+            window_bytes = stats.bytes_done;
+            window_latency_ns = stats.latency_ns;
+            window_n_done = stats.n_done;
+        }
+
+        stats.in_flight++;
+        pthread_mutex_unlock(&stats.mutex);
+
+        /* Merge up to ctl.coalesce chunks that sit back to back in the file.
+         * Requests are packed into the front of params, which never overtakes
+         * the chunk map entries still to be read.
+         */
+        req = &params[n_requests++];
+        req->chunk_n = (uint32_t)next;
+        req->addr = params[next].addr;
+        req->size = params[next].size;
+        req->n_chunks = 1;
+        next++;
+        while (next < nchunks && req->n_chunks < (uint32_t)ctl.coalesce &&
+                params[next].addr == req->addr + req->size &&
+                params[next].size == chunk_size_g * elem_size_g) {
+            req->size += params[next].size;
+            req->n_chunks++;
+            next++;
+        }
+        req->stats = &stats;
+        clock_gettime(CLOCK_MONOTONIC, &req->issue_ts);
+
+        if (thpool_add_work(pool, read_and_verify_auto, (void *)req) < 0) {
+            pthread_mutex_lock(&stats.mutex);
+            stats.in_flight--;
+            stats.failed = true;
+            break;
+        }
+
+        pthread_mutex_lock(&stats.mutex);
+    }
+    while (stats.in_flight > 0)
+        pthread_cond_wait(&stats.cond, &stats.mutex);
+    pthread_mutex_unlock(&stats.mutex);
+
+    if (stats.failed)
+        goto error;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent reading (via CLOCK_MONOTONIC)\n");
+    printf("Bandwidth: ");
+    print_bandwidth(total_bytes, start_ts, end_ts);
+    printf("Final depth: %d  Final request size: %d chunk(s)  Requests: %llu\n", ctl.depth, ctl.coalesce,
+            n_requests);
+    if (settled_at < 0)
+        printf("Controller did not settle");
+    else
+        printf("Controller settled after %.2f%% of the data", settled_at);
+    printf(" (re-tuned %d time(s))\n", ctl.n_retunes);
+
+    if (close(fd_g) < 0)
+        goto error;
+    fd_g = -1;
+
+    thpool_destroy(pool);
+
+    pthread_mutex_destroy(&stats.mutex);
+    pthread_cond_destroy(&stats.cond);
+
+    free(params);
+
+    return 0;
+
+error:
+
+    if (pool)
+        thpool_destroy(pool);
+
+    if (fd_g > -1)
+        close(fd_g);
+    fd_g = -1;
+
+    pthread_mutex_destroy(&stats.mutex);
+    pthread_cond_destroy(&stats.cond);
+
+    free(params);
+
+    return -1;
+} /* posix_mt_auto */
+
+/* Multi-dataset, multi-file scheduling
+ *
+ * Reads a list of (file, dataset, selection) targets with one shared thread
+ * pool. All the HDF5 work (opening files and datasets and building the chunk
+ * maps) happens in a single pass on the main thread before any I/O starts,
+ * after which the HDF5 objects are closed and only one POSIX fd per file is
+ * kept. The chunk reads are queued round-robin across targets, one chunk per
+ * target per round, so small targets finish early and large ones can't hog
+ * the queue. Each target's chunks are taken in file address order and each
+ * round is sorted by (file, address).
+ */
+
+#define MAX_TARGET_LINE 4096
+
+typedef struct multi_file_t {
+    char *name;
+    int fd;
+} multi_file_t;
+
+typedef struct multi_target_t {
+    size_t file_idx;
+    multi_file_t *file;
+    char *dset_name;
+    hsize_t start;              /* Selection, in elements */
+    hsize_t count;
+
+    /* Each target has its own geometry and element type */
+    hsize_t dims;
+    hsize_t chunk_dims;
+    elem_type_e type;
+
+    struct multi_params_t *chunks;
+    hsize_t n_chunks;
+    hsize_t next;               /* Next chunk to schedule */
+
+    pthread_mutex_t mutex;
+    hsize_t n_remaining;
+    uint64_t n_bytes;
+    struct timespec done_ts;
+} multi_target_t;
+
+typedef struct multi_params_t {
+    multi_target_t *target;
+    uint32_t chunk_n;
+    haddr_t addr;
+    hsize_t size;
+} multi_params_t;
+
+int
+compare_multi_addr(const void *a, const void *b)
+{
+    const multi_params_t *x = *(const multi_params_t * const *)a;
+    const multi_params_t *y = *(const multi_params_t * const *)b;
+
+    if (x->target->file != y->target->file)
+        return (x->target->file > y->target->file) - (x->target->file < y->target->file);
+
+    return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+int
+compare_chunk_addr(const void *a, const void *b)
+{
+    haddr_t x = ((const multi_params_t *)a)->addr;
+    haddr_t y = ((const multi_params_t *)b)->addr;
+
+    return (x > y) - (x < y);
+}
+
+void
+multi_read_and_verify(void *arg)
+{
+    multi_params_t *params = (multi_params_t *)arg;
+    multi_target_t *target = params->target;
+
+    hsize_t first = (hsize_t)params->chunk_n * target->chunk_dims;
+    hsize_t count = (target->dims - first < target->chunk_dims) ? target->dims - first : target->chunk_dims;
+
+    void *buf = NULL;
+
+    if (NULL == (buf = malloc(params->size)))
+        goto error;
+
+    /* Read the data */
+    if (pread(target->file->fd, buf, params->size, (off_t)(params->addr)) < 0)
+        goto error;
+
+    if (verify_typed(buf, target->type, params->chunk_n, count, 0) < 0)
+        goto error;
+
+    free(buf);
+
+    pthread_mutex_lock(&target->mutex);
+    if (0 == --target->n_remaining)
+        clock_gettime(CLOCK_MONOTONIC, &target->done_ts);
+    pthread_mutex_unlock(&target->mutex);
+
+    return;
+
+error:
+    printf("BADNESS in callback! file: %s dataset: %s addr: %lu size: %llu\n", target->file->name,
+            target->dset_name, params->addr, params->size);
+    free(buf);
+    return;
+}
+
+/* Parses the target list. Each line is
+ *
+ *      <file> <dataset> [<start> <count>]
+ *
+ * with the optional selection given in elements. Blank lines and lines
+ * starting with # are ignored. Files named more than once share an entry.
+ */
+int
+parse_targets(const char *list_name, multi_file_t **files_out, size_t *n_files_out,
+        multi_target_t **targets_out, size_t *n_targets_out)
+{
+    FILE *list = NULL;
+    char line[MAX_TARGET_LINE];
+    char file_name[MAX_TARGET_LINE];
+    char dset_name[MAX_TARGET_LINE];
+    unsigned long long start = 0;
+    unsigned long long count = 0;
+
+    multi_file_t *files = NULL;
+    multi_target_t *targets = NULL;
+    size_t n_files = 0;
+    size_t n_targets = 0;
+    size_t f;
+    int n;
+
+    if (NULL == (list = fopen(list_name, "r")))
+        goto error;
+
+    while (fgets(line, sizeof(line), list)) {
+        void *tmp;
+
+        if ((n = sscanf(line, "%s %s %llu %llu", file_name, dset_name, &start, &count)) < 1 ||
+                '#' == file_name[0])
+            continue;
+        if (n != 2 && n != 4) {
+            printf("BADNESS: Can't parse target: %s", line);
+            goto error;
+        }
+
+        for (f = 0; f < n_files; f++)
+            if (!strcmp(files[f].name, file_name))
+                break;
+        if (f == n_files) {
+            if (NULL == (tmp = realloc(files, (n_files + 1) * sizeof(multi_file_t))))
+                goto error;
+            files = tmp;
+            files[n_files].name = strdup(file_name);
+            files[n_files].fd = -1;
+            n_files++;
+        }
+
+        if (NULL == (tmp = realloc(targets, (n_targets + 1) * sizeof(multi_target_t))))
+            goto error;
+        targets = tmp;
+        memset(&targets[n_targets], 0, sizeof(multi_target_t));
+        targets[n_targets].file_idx = f;
+        targets[n_targets].dset_name = strdup(dset_name);
+        targets[n_targets].start = (4 == n) ? start : 0;
+        targets[n_targets].count = (4 == n) ? count : 0;          /* 0 is the whole dataset */
+        n_targets++;
+    }
+
+    fclose(list);
+
+    /* The files array has stopped moving, so indexes can become pointers */
+    for (size_t u = 0; u < n_targets; u++)
+        targets[u].file = &files[targets[u].file_idx];
+
+    *files_out = files;
+    *n_files_out = n_files;
+    *targets_out = targets;
+    *n_targets_out = n_targets;
+
+    return 0;
+
+error:
+    if (list)
+        fclose(list);
+
+    for (f = 0; f < n_files; f++)
+        free(files[f].name);
+    free(files);
+    for (size_t u = 0; u < n_targets; u++)
+        free(targets[u].dset_name);
+    free(targets);
+
+    return -1;
+} /* parse_targets */
+
+/* Builds a target's chunk map, sorted by address. HDF5 calls only. */
+int
+build_target_map(hid_t fid, multi_target_t *target)
+{
+    hid_t did = H5I_INVALID_HID;
+    hid_t sid = H5I_INVALID_HID;
+    hid_t dcpl_id = H5I_INVALID_HID;
+
+    hsize_t dims = 0;
+    hsize_t chunk_dims = 0;
+    hsize_t offset = 0;
+    hsize_t first = 0;
+    hsize_t last = 0;
+    uint32_t mask = 0;
+
+    if (H5I_INVALID_HID == (did = H5Dopen2(fid, target->dset_name, H5P_DEFAULT)))
+        goto error;
+    if (H5I_INVALID_HID == (sid = H5Dget_space(did)))
+        goto error;
+    if (1 != H5Sget_simple_extent_ndims(sid) || H5Sget_simple_extent_dims(sid, &dims, NULL) < 0)
+        goto error;
+    if (H5I_INVALID_HID == (dcpl_id = H5Dget_create_plist(did)))
+        goto error;
+    if (H5D_CHUNKED != H5Pget_layout(dcpl_id) || 1 != H5Pget_chunk(dcpl_id, 1, &chunk_dims))
+        goto error;
+    if (ELEM_N_TYPES == (target->type = elem_type_of(did)))
+        goto error;
+
+    target->dims = dims;
+    target->chunk_dims = chunk_dims;
+
+    if (0 == target->count)
+        target->count = dims - target->start;
+    if (0 == target->count || target->start + target->count > dims)
+        goto error;
+
+    first = target->start / chunk_dims;
+    last = (target->start + target->count - 1) / chunk_dims;
+
+    target->n_chunks = last - first + 1;
+    if (NULL == (target->chunks = calloc(target->n_chunks, sizeof(multi_params_t))))
+        goto error;
+
+    for (hsize_t u = 0; u < target->n_chunks; u++) {
+        multi_params_t *chunk = &target->chunks[u];
+
+        offset = (first + u) * chunk_dims;
+
+        chunk->target = target;
+        chunk->chunk_n = (uint32_t)(first + u);
+        if (H5Dget_chunk_info_by_coord(did, &offset, &mask, &chunk->addr, &chunk->size) < 0)
+            goto error;
+        target->n_bytes += chunk->size;
+    }
+
+    qsort(target->chunks, target->n_chunks, sizeof(multi_params_t), compare_chunk_addr);
+
+    target->n_remaining = target->n_chunks;
+
+    if (H5Pclose(dcpl_id) < 0)
+        goto error;
+    if (H5Sclose(sid) < 0)
+        goto error;
+    if (H5Dclose(did) < 0)
+        goto error;
+
+    return 0;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Pclose(dcpl_id);
+        H5Sclose(sid);
+        H5Dclose(did);
+    } H5E_END_TRY;
+
+    printf("BADNESS: Can't map %s in %s (must be a chunked 1D dataset of a supported type with a valid selection)\n",
+            target->dset_name, target->file->name);
+
+    return -1;
+} /* build_target_map */
+
+int
+posix_multi(const char *list_name, int n_threads)
+{
+    hid_t fid = H5I_INVALID_HID;
+
+    multi_file_t *files = NULL;
+    multi_target_t *targets = NULL;
+    size_t n_files = 0;
+    size_t n_targets = 0;
+
+    multi_params_t **round = NULL;
+    size_t n_round = 0;
+    bool scheduled = false;
+    uint64_t total_bytes = 0;
+
+    struct timespec start_ts;
+    struct timespec end_ts;
+
+    threadpool pool = NULL;
+
+    printf("Multithreaded POSIX I/O calls (multiple targets)\n");
+
+    if (parse_targets(list_name, &files, &n_files, &targets, &n_targets) < 0)
+        goto error;
+    printf("Targets: %zu  Files: %zu\n", n_targets, n_files);
+    if (0 == n_targets)
+        goto error;
+
+    for (size_t t = 0; t < n_targets; t++)
+        pthread_mutex_init(&targets[t].mutex, NULL);
+
+    /* Create the thread pool */
+    if (NULL == (pool = thpool_init(n_threads)))
+        goto error;
+    printf("Number of threads: %d\n", n_threads);
+
+    /* Do all the HDF5 work in one pass, file by file */
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    for (size_t f = 0; f < n_files; f++) {
+        if (H5I_INVALID_HID == (fid = H5Fopen(files[f].name, H5F_ACC_RDONLY, H5P_DEFAULT)))
+            goto error;
+
+        for (size_t t = 0; t < n_targets; t++)
+            if (targets[t].file == &files[f])
+                if (build_target_map(fid, &targets[t]) < 0)
+                    goto error;
+
+        if (H5Fclose(fid) < 0)
+            goto error;
+        fid = H5I_INVALID_HID;
+
+        /* Open the HDF5 file for POSIX I/O */
+        if ((files[f].fd = open(files[f].name, O_RDONLY)) < 0)
+            goto error;
+    }
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent building the chunk maps (via CLOCK_MONOTONIC)\n");
+
+    if (NULL == (round = malloc(n_targets * sizeof(multi_params_t *))))
+        goto error;
+
+    /* Queue one chunk per unfinished target per round */
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    while (!scheduled) {
+        n_round = 0;
+        for (size_t t = 0; t < n_targets; t++)
+            if (targets[t].next < targets[t].n_chunks)
+                round[n_round++] = &targets[t].chunks[targets[t].next++];
+
+        qsort(round, n_round, sizeof(multi_params_t *), compare_multi_addr);
+
+        for (size_t u = 0; u < n_round; u++)
+            if (thpool_add_work(pool, multi_read_and_verify, (void *)round[u]) < 0)
+                goto error;
+
+        scheduled = (0 == n_round);
+    }
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent launching threads (via CLOCK_MONOTONIC)\n");
+
+    thpool_wait(pool);
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent reading all targets (via CLOCK_MONOTONIC)\n");
+
+    /* Report */
+    for (size_t t = 0; t < n_targets; t++) {
+        if (targets[t].n_remaining > 0) {
+            printf("BADNESS: %s in %s did not finish\n", targets[t].dset_name, targets[t].file->name);
+            goto error;
+        }
+        printf("%s:%s [%llu, %llu)  ", targets[t].file->name, targets[t].dset_name,
+                targets[t].start, targets[t].start + targets[t].count);
+        print_elapsed_sec(start_ts, targets[t].done_ts);
+        printf("  ");
+        print_bandwidth(targets[t].n_bytes, start_ts, targets[t].done_ts);
+        total_bytes += targets[t].n_bytes;
+    }
+    printf("Bandwidth: ");
+    print_bandwidth(total_bytes, start_ts, end_ts);
+
+    thpool_destroy(pool);
+    pool = NULL;
+
+    for (size_t f = 0; f < n_files; f++)
+        if (close(files[f].fd) < 0)
+            goto error;
+
+    free(round);
+    for (size_t f = 0; f < n_files; f++)
+        free(files[f].name);
+    free(files);
+    for (size_t t = 0; t < n_targets; t++) {
+        free(targets[t].dset_name);
+        free(targets[t].chunks);
+        pthread_mutex_destroy(&targets[t].mutex);
+    }
+    free(targets);
+
+    return 0;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Fclose(fid);
+    } H5E_END_TRY;
+
+    if (pool)
+        thpool_destroy(pool);
+
+    for (size_t f = 0; f < n_files; f++)
+        if (files[f].fd > -1)
+            close(files[f].fd);
+
+    free(round);
+    for (size_t f = 0; f < n_files; f++)
+        free(files[f].name);
+    free(files);
+    for (size_t t = 0; t < n_targets; t++) {
+        free(targets[t].dset_name);
+        free(targets[t].chunks);
+        pthread_mutex_destroy(&targets[t].mutex);
+    }
+    free(targets);
+
+    return -1;
+} /* posix_multi */
+
+/* Virtual datasets
+ *
+ * The mappings of a virtual dataset are resolved once on the main thread.
+ * Each source dataset's chunk map is built, and every chunk that overlaps a
+ * mapping becomes a piece that is pread straight into its place in the
+ * destination buffer, so nothing is copied afterwards. Pieces from all the
+ * source files are queued round-robin by file on one thread pool, in address
+ * order within each file. Mappings must be 1D runs of elements and the source
+ * datasets chunked and unfiltered.
+ */
+
+/* Shared by every piece, so failed reads can be counted */
+typedef struct vds_status_t {
+    pthread_mutex_t mutex;
+    size_t n_remaining;         /* Pieces not yet read and verified */
+} vds_status_t;
+
+typedef struct vds_piece_t {
+    vds_status_t *status;
+    size_t file_idx;
+    multi_file_t *file;
+    haddr_t addr;
+    hsize_t size;
+    void *dest;
+    hsize_t first_element;      /* In the virtual dataset */
+} vds_piece_t;
+
+int
+compare_vds_piece(const void *a, const void *b)
+{
+    const vds_piece_t *x = (const vds_piece_t *)a;
+    const vds_piece_t *y = (const vds_piece_t *)b;
+
+    if (x->file != y->file)
+        return (x->file > y->file) - (x->file < y->file);
+
+    return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+void
+vds_read_and_verify(void *arg)
+{
+    vds_piece_t *piece = (vds_piece_t *)arg;
+
+    hsize_t n_read = 0;
+    ssize_t ret;
+
+    /* Read the data */
+    while (n_read < piece->size) {
+        if ((ret = pread(piece->file->fd, (char *)piece->dest + n_read, piece->size - n_read,
+                        (off_t)(piece->addr + n_read))) <= 0)
+            goto error;
+        n_read += ret;
+    }
+
+    if (verify_range(piece->dest, piece->first_element, piece->size / elem_size_g) < 0)
+        goto error;
+
+    pthread_mutex_lock(&piece->status->mutex);
+    piece->status->n_remaining--;
+    pthread_mutex_unlock(&piece->status->mutex);
+
+    return;
+
+error:
+    printf("BADNESS in callback! file: %s addr: %lu size: %llu\n", piece->file->name, piece->addr, piece->size);
+    return;
+}
+
+/* Gets the single run of elements [*start, *start + *count) that a
+ * selection covers. Fails for anything that isn't one run in 1D.
+ */
+int
+get_selection_run(hid_t sid, hsize_t *start, hsize_t *count)
+{
+    hsize_t end = 0;
+    hssize_t n_points = 0;
+
+    if (1 != H5Sget_simple_extent_ndims(sid))
+        return -1;
+    if ((n_points = H5Sget_select_npoints(sid)) <= 0)
+        return -1;
+    if (H5Sget_select_bounds(sid, start, &end) < 0)
+        return -1;
+    if ((hsize_t)n_points != end - *start + 1)
+        return -1;
+
+    *count = (hsize_t)n_points;
+
+    return 0;
+} /* get_selection_run */
+
+/* Adds the pieces for one mapping, whose source dataset is open as did. */
+int
+map_vds_source(hid_t did, size_t file_idx, hsize_t v_start, hsize_t s_start, hsize_t count, void *buf,
+        vds_piece_t **pieces, size_t *n_pieces, size_t *max_pieces)
+{
+    hid_t dcpl_id = H5I_INVALID_HID;
+
+    hsize_t chunk_dims = 0;
+    hsize_t offset = 0;
+    uint32_t mask = 0;
+    haddr_t addr = HADDR_UNDEF;
+    hsize_t size = 0;
+
+    if (H5I_INVALID_HID == (dcpl_id = H5Dget_create_plist(did)))
+        goto error;
+    if (H5D_CHUNKED != H5Pget_layout(dcpl_id) || 1 != H5Pget_chunk(dcpl_id, 1, &chunk_dims))
+        goto error;
+    if (0 != H5Pget_nfilters(dcpl_id))
+        goto error;
+    if (elem_type_of(did) != elem_type_g)
+        goto error;
+
+    for (hsize_t c = s_start / chunk_dims; c * chunk_dims < s_start + count; c++) {
+        hsize_t lo = c * chunk_dims;
+        hsize_t hi = lo + chunk_dims;
+        vds_piece_t *piece;
+
+        /* Clip the chunk to the source selection */
+        if (lo < s_start)
+            lo = s_start;
+        if (hi > s_start + count)
+            hi = s_start + count;
+
+        offset = c * chunk_dims;
+        if (H5Dget_chunk_info_by_coord(did, &offset, &mask, &addr, &size) < 0)
+            goto error;
+        if (HADDR_UNDEF == addr)
+            goto error;
+
+        if (*n_pieces == *max_pieces) {
+            void *tmp;
+
+            *max_pieces = *max_pieces ? *max_pieces * 2 : 1024;
+            if (NULL == (tmp = realloc(*pieces, *max_pieces * sizeof(vds_piece_t))))
+                goto error;
+            *pieces = tmp;
+        }
+
+        piece = &(*pieces)[(*n_pieces)++];
+        piece->file_idx = file_idx;
+        piece->addr = addr + (lo - c * chunk_dims) * elem_size_g;
+        piece->size = (hi - lo) * elem_size_g;
+        piece->first_element = v_start + (lo - s_start);
+        piece->dest = (char *)buf + (piece->first_element * elem_size_g);
+    }
+
+    if (H5Pclose(dcpl_id) < 0)
+        goto error;
+
+    return 0;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Pclose(dcpl_id);
+    } H5E_END_TRY;
+
+    return -1;
+} /* map_vds_source */
+
+int
+posix_mt_virtual(hid_t did, const char *filename, int n_threads)
+{
+    hid_t dcpl_id = H5I_INVALID_HID;
+    hid_t sid = H5I_INVALID_HID;
+    hid_t vsid = H5I_INVALID_HID;
+    hid_t ssid = H5I_INVALID_HID;
+    hid_t src_fid = H5I_INVALID_HID;
+    hid_t src_did = H5I_INVALID_HID;
+
+    size_t n_mappings = 0;
+    hssize_t n_elements = 0;
+    hsize_t v_start = 0;
+    hsize_t s_start = 0;
+    hsize_t v_count = 0;
+    hsize_t s_count = 0;
+
+    multi_file_t *files = NULL;
+    size_t n_files = 0;
+    vds_piece_t *pieces = NULL;
+    size_t n_pieces = 0;
+    size_t max_pieces = 0;
+    size_t *next = NULL;
+    size_t *end = NULL;
+    bool queued = false;
+    uint64_t total_bytes = 0;
+    vds_status_t status;
+
+    char *dir = NULL;
+    char *name = NULL;
+    char *dset_name = NULL;
+    char *path = NULL;
+    ssize_t len;
+    size_t f;
+
+    void *buf = NULL;
+
+    struct timespec start_ts;
+    struct timespec end_ts;
+
+    threadpool pool = NULL;
+
+    printf("Multithreaded POSIX I/O calls (virtual dataset)\n");
+
+    pthread_mutex_init(&status.mutex, NULL);
+
+    /* Relative source file names are relative to the virtual dataset's file */
+    if (NULL == (dir = strdup(filename)))
+        goto error;
+    if (strrchr(dir, '/'))
+        *(strrchr(dir, '/') + 1) = '\0';
+    else
+        dir[0] = '\0';
+
+    if (H5I_INVALID_HID == (sid = H5Dget_space(did)))
+        goto error;
+    if ((n_elements = H5Sget_simple_extent_npoints(sid)) < 0)
+        goto error;
+
+    /* The destination buffer is the whole virtual dataset */
+    if (NULL == (buf = calloc(n_elements, elem_size_g)))
+        goto error;
+
+    /* Create the thread pool */
+    if (NULL == (pool = thpool_init(n_threads)))
+        goto error;
+    printf("Number of threads: %d\n", n_threads);
+
+    /* Resolve the mappings and build the source chunk maps */
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+
+    if (H5I_INVALID_HID == (dcpl_id = H5Dget_create_plist(did)))
+        goto error;
+    if (H5Pget_virtual_count(dcpl_id, &n_mappings) < 0)
+        goto error;
+
+    for (size_t i = 0; i < n_mappings; i++) {
+        if ((len = H5Pget_virtual_filename(dcpl_id, i, NULL, 0)) < 0)
+            goto error;
+        if (NULL == (name = malloc(len + 1)))
+            goto error;
+        if (H5Pget_virtual_filename(dcpl_id, i, name, len + 1) < 0)
+            goto error;
+
+        if ((len = H5Pget_virtual_dsetname(dcpl_id, i, NULL, 0)) < 0)
+            goto error;
+        if (NULL == (dset_name = malloc(len + 1)))
+            goto error;
+        if (H5Pget_virtual_dsetname(dcpl_id, i, dset_name, len + 1) < 0)
+            goto error;
+
+        /* "." is the virtual dataset's own file */
+        if (NULL == (path = malloc(strlen(dir) + strlen(filename) + strlen(name) + 1)))
+            goto error;
+        if (!strcmp(name, "."))
+            strcpy(path, filename);
+        else if ('/' == name[0])
+            strcpy(path, name);
+        else
+            sprintf(path, "%s%s", dir, name);
+
+        if (H5I_INVALID_HID == (vsid = H5Pget_virtual_vspace(dcpl_id, i)))
+            goto error;
+        if (H5I_INVALID_HID == (ssid = H5Pget_virtual_srcspace(dcpl_id, i)))
+            goto error;
+
+        /* One entry, and one fd, per source file */
+        for (f = 0; f < n_files; f++)
+            if (!strcmp(files[f].name, path))
+                break;
+        if (f == n_files) {
+            void *tmp;
+
+            if (NULL == (tmp = realloc(files, (n_files + 1) * sizeof(multi_file_t))))
+                goto error;
+            files = tmp;
+            files[n_files].name = path;
+            files[n_files].fd = -1;
+            n_files++;
+            path = NULL;
+        }
+
+        if (H5I_INVALID_HID == (src_fid = H5Fopen(files[f].name, H5F_ACC_RDONLY, H5P_DEFAULT)))
+            goto error;
+        if (H5I_INVALID_HID == (src_did = H5Dopen2(src_fid, dset_name, H5P_DEFAULT)))
+            goto error;
+
+        /* An "all" source selection has no extent of its own, so it
+         * comes from the source dataset
+         */
+        if (H5S_SEL_ALL == H5Sget_select_type(ssid)) {
+            if (H5Sclose(ssid) < 0)
+                goto error;
+            if (H5I_INVALID_HID == (ssid = H5Dget_space(src_did)))
+                goto error;
+        }
+
+        if (get_selection_run(vsid, &v_start, &v_count) < 0 || get_selection_run(ssid, &s_start, &s_count) < 0 ||
+                v_count != s_count) {
+            printf("BADNESS: Mapping %zu is not a single 1D run of elements\n", i);
+            goto error;
+        }
+
+        if (map_vds_source(src_did, f, v_start, s_start, s_count, buf, &pieces, &n_pieces, &max_pieces) < 0) {
+            printf("BADNESS: Can't map %s in %s (must be chunked, unfiltered and the same type)\n", dset_name,
+                    files[f].name);
+            goto error;
+        }
+
+        if (H5Dclose(src_did) < 0)
+            goto error;
+        src_did = H5I_INVALID_HID;
+        if (H5Fclose(src_fid) < 0)
+            goto error;
+        src_fid = H5I_INVALID_HID;
+        if (H5Sclose(vsid) < 0)
+            goto error;
+        vsid = H5I_INVALID_HID;
+        if (H5Sclose(ssid) < 0)
+            goto error;
+        ssid = H5I_INVALID_HID;
+
+        free(name);
+        name = NULL;
+        free(dset_name);
+        dset_name = NULL;
+        free(path);
+        path = NULL;
+    }
+
+    /* The files array has stopped moving, so indexes can become pointers */
+    for (f = 0; f < n_files; f++)
+        if ((files[f].fd = open(files[f].name, O_RDONLY)) < 0)
+            goto error;
+    for (size_t u = 0; u < n_pieces; u++) {
+        pieces[u].file = &files[pieces[u].file_idx];
+        pieces[u].status = &status;
+    }
+    status.n_remaining = n_pieces;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent resolving %zu mappings in %zu source files (via CLOCK_MONOTONIC)\n", n_mappings, n_files);
+
+    /* Group the pieces by file in address order, then deal them out
+     * round-robin across files
+     */
+    qsort(pieces, n_pieces, sizeof(vds_piece_t), compare_vds_piece);
+
+    if (NULL == (next = calloc(n_files + 1, sizeof(size_t))))
+        goto error;
+    if (NULL == (end = calloc(n_files + 1, sizeof(size_t))))
+        goto error;
+    for (size_t u = 0; u < n_pieces; u++) {
+        f = pieces[u].file - files;
+        if (0 == end[f])
+            next[f] = u;
+        end[f] = u + 1;
+        total_bytes += pieces[u].size;
+    }
+
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    while (!queued) {
+        queued = true;
+        for (f = 0; f < n_files; f++)
+            if (next[f] < end[f]) {
+                if (thpool_add_work(pool, vds_read_and_verify, (void *)&pieces[next[f]++]) < 0)
+                    goto error;
+                queued = false;
+            }
+    }
+    thpool_wait(pool);
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent reading %zu pieces (via CLOCK_MONOTONIC)\n", n_pieces);
+    printf("Bandwidth: ");
+    print_bandwidth(total_bytes, start_ts, end_ts);
+
+    thpool_destroy(pool);
+    pool = NULL;
+
+    if (status.n_remaining > 0) {
+        printf("BADNESS: %zu of %zu pieces failed\n", status.n_remaining, n_pieces);
+        goto error;
+    }
+
+    for (f = 0; f < n_files; f++)
+        if (close(files[f].fd) < 0)
+            goto error;
+
+    if (H5Pclose(dcpl_id) < 0)
+        goto error;
+    if (H5Sclose(sid) < 0)
+        goto error;
+
+    for (f = 0; f < n_files; f++)
+        free(files[f].name);
+    free(files);
+    free(pieces);
+    free(next);
+    free(end);
+    free(buf);
+    free(dir);
+
+    pthread_mutex_destroy(&status.mutex);
+
+    return 0;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Dclose(src_did);
+        H5Fclose(src_fid);
+        H5Sclose(vsid);
+        H5Sclose(ssid);
+        H5Sclose(sid);
+        H5Pclose(dcpl_id);
+    } H5E_END_TRY;
+
+    /* Let any reads still in flight land before freeing their buffer */
+    if (pool)
+        thpool_destroy(pool);
+
+    for (f = 0; f < n_files; f++) {
+        if (files[f].fd > -1)
+            close(files[f].fd);
+        free(files[f].name);
+    }
+    free(files);
+    free(pieces);
+    free(next);
+    free(end);
+    free(buf);
+    free(dir);
+    free(name);
+    free(dset_name);
+    free(path);
+
+    pthread_mutex_destroy(&status.mutex);
+
+    return -1;
+} /* posix_mt_virtual */
+
+/* Random-access batched sampling
+ *
+ * Simulates an ML-style training loop that pulls random batches of elements
+ * from the dataset. Each batch of sampled element indices is mapped to the
+ * chunks that contain them, deduplicated, and sorted by file address before
+ * the chunk reads are handed to the thread pool. With prefetch on, the next
+ * batch is looked up and issued before the current one is consumed.
+ */
+
+typedef struct batch_t {
+    struct sample_params_t *params;     /* One entry per unique chunk */
+    char *buf;                          /* One chunk per entry */
+    size_t n_chunks;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    size_t n_done;
+    bool failed;
+
+    struct timespec issue_ts;
+    struct timespec done_ts;
+} batch_t;
+
+typedef struct sample_params_t {
+    batch_t *batch;
+    uint32_t chunk_n;
+    haddr_t addr;
+    hsize_t size;
+    void *buf;
+} sample_params_t;
+
+/* splitmix64, so a given seed samples the same indices everywhere */
+uint64_t
+sample_next(uint64_t *state)
+{
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+    return z ^ (z >> 31);
+}
+
+int
+compare_uint32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+int
+compare_sample_addr(const void *a, const void *b)
+{
+    haddr_t x = ((const sample_params_t *)a)->addr;
+    haddr_t y = ((const sample_params_t *)b)->addr;
+
+    return (x > y) - (x < y);
+}
+
+int
+compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+void
+sample_read(void *arg)
+{
+    sample_params_t *params = (sample_params_t *)arg;
+    batch_t *batch = params->batch;
+    bool failed = false;
+
+    if (pread(fd_g, params->buf, params->size, (off_t)(params->addr)) < 0) {
+        printf("BADNESS in callback! addr: %lu size: %llu\n", params->addr, params->size);
+        failed = true;
+    }
+
+    pthread_mutex_lock(&batch->mutex);
+    if (failed)
+        batch->failed = true;
+    if (++batch->n_done == batch->n_chunks) {
+        clock_gettime(CLOCK_MONOTONIC, &batch->done_ts);
+        pthread_cond_signal(&batch->cond);
+    }
+    pthread_mutex_unlock(&batch->mutex);
+}
+
+/* Draws the next batch of element indices, maps them to chunks and
+ * hands the reads to the thread pool in file address order.
+ */
+int
+issue_batch(hid_t did, threadpool pool, batch_t *batch, uint32_t *chunk_ns, uint64_t *rng_state,
+        int batch_size)
+{
+    hsize_t offset = 0;
+    uint32_t mask = 0;
+    size_t n_unique = 0;
+
+    /* Sample element indices and map them to chunks */
+    for (int i = 0; i < batch_size; i++)
+        chunk_ns[i] = (uint32_t)((sample_next(rng_state) % dset_size_g) / chunk_size_g);
+
+    /* Deduplicate */
+    qsort(chunk_ns, batch_size, sizeof(uint32_t), compare_uint32);
+    for (int i = 0; i < batch_size; i++)
+        if (0 == n_unique || chunk_ns[i] != chunk_ns[n_unique - 1])
+            chunk_ns[n_unique++] = chunk_ns[i];
+
+    /* Look up the chunk addresses (HDF5 calls stay on the main thread) */
+    for (size_t u = 0; u < n_unique; u++) {
+        offset = (hsize_t)chunk_ns[u] * chunk_size_g;
+
+        batch->params[u].batch = batch;
+        batch->params[u].chunk_n = chunk_ns[u];
+        if (H5Dget_chunk_info_by_coord(did, &offset, &mask, &(batch->params[u].addr), &(batch->params[u].size)) < 0)
+            return -1;
+    }
+
+    /* Sort by file address */
+    qsort(batch->params, n_unique, sizeof(sample_params_t), compare_sample_addr);
+
+    batch->n_chunks = n_unique;
+    batch->n_done = 0;
+    batch->failed = false;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &batch->issue_ts) < 0)
+        return -1;
+
+    for (size_t u = 0; u < n_unique; u++) {
+        batch->params[u].buf = batch->buf + (u * chunk_size_g * elem_size_g);
+        if (thpool_add_work(pool, sample_read, (void *)&batch->params[u]) < 0)
+            return -1;
+    }
+
+    return 0;
+} /* issue_batch */
+
+int
+posix_sample(hid_t did, const char *filename, int n_threads, uint64_t seed, int batch_size,
+        int n_batches, bool prefetch)
+{
+    batch_t batches[2];
+    int n_slots = prefetch ? 2 : 1;
+    hsize_t max_chunks = (dset_size_g + chunk_size_g - 1) / chunk_size_g;
+
+    uint32_t *chunk_ns = NULL;
+    double *latencies = NULL;
+    uint64_t rng_state = seed;
+    uint64_t n_bytes = 0;
+
+    struct timespec start_ts;
+    struct timespec end_ts;
+
+    threadpool pool = NULL;
+
+    printf("Random-access batched sampling (POSIX I/O)\n");
+    printf("Number of threads: %d\n", n_threads);
+    printf("Seed: %llu  Batch size: %d elements  Batches: %d  Prefetch: %s\n",
+            (unsigned long long)seed, batch_size, n_batches, prefetch ? "yes" : "no");
+
+    memset(batches, 0, sizeof(batches));
+    for (int i = 0; i < 2; i++) {
+        pthread_mutex_init(&batches[i].mutex, NULL);
+        pthread_cond_init(&batches[i].cond, NULL);
+    }
+
+    if (batch_size < 1 || n_batches < 1)
+        goto error;
+
+    if (NULL == (pool = thpool_init(n_threads)))
+        goto error;
+
+    /* Open the HDF5 file for POSIX I/O */
+    if ((fd_g = open(filename, O_RDONLY)) < 0)
+        goto error;
+
+    /* A batch can't touch more chunks than it has samples, or than the
+     * dataset has
+     */
+    if (max_chunks > (hsize_t)batch_size)
+        max_chunks = (hsize_t)batch_size;
+    for (int i = 0; i < n_slots; i++) {
+        if (NULL == (batches[i].params = calloc(max_chunks, sizeof(sample_params_t))) ||
+                NULL == (batches[i].buf = malloc(max_chunks * chunk_size_g * elem_size_g))) {
+            printf("BADNESS: Can't allocate buffers for %llu chunks per batch\n", max_chunks);
+            goto error;
+        }
+    }
+    if (NULL == (chunk_ns = malloc(batch_size * sizeof(uint32_t))))
+        goto error;
+    if (NULL == (latencies = malloc(n_batches * sizeof(double))))
+        goto error;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+
+    if (issue_batch(did, pool, &batches[0], chunk_ns, &rng_state, batch_size) < 0)
+        goto error;
+
+    for (int k = 0; k < n_batches; k++) {
+        batch_t *cur = &batches[k % n_slots];
+
+        /* Get the next batch in flight before consuming this one */
+        if (prefetch && k + 1 < n_batches)
+            if (issue_batch(did, pool, &batches[(k + 1) % n_slots], chunk_ns, &rng_state, batch_size) < 0)
+                goto error;
+
+        pthread_mutex_lock(&cur->mutex);
+        while (cur->n_done < cur->n_chunks)
+            pthread_cond_wait(&cur->cond, &cur->mutex);
+        pthread_mutex_unlock(&cur->mutex);
+
+        if (cur->failed)
+            goto error;
+
+        latencies[k] = (ns_from_timespec(cur->done_ts) - ns_from_timespec(cur->issue_ts)) / 1E9;
+
+        /* Consume the batch */
+        for (size_t u = 0; u < cur->n_chunks; u++) {
+            if (verify(cur->params[u].buf, cur->params[u].chunk_n, chunk_elements(cur->params[u].chunk_n)) < 0)
+                goto error;
+            n_bytes += cur->params[u].size;
+        }
+
+        if (!prefetch && k + 1 < n_batches)
+            if (issue_batch(did, pool, cur, chunk_ns, &rng_state, batch_size) < 0)
+                goto error;
+    }
+
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+
+    /* Report */
+    qsort(latencies, n_batches, sizeof(double), compare_double);
+
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent sampling all batches (via CLOCK_MONOTONIC)\n");
+    printf("%f batches/s\n", n_batches / ((ns_from_timespec(end_ts) - ns_from_timespec(start_ts)) / 1E9));
+    printf("Batch latency p50: %f s  p90: %f s  p99: %f s  max: %f s\n",
+            latencies[(n_batches - 1) * 50 / 100], latencies[(n_batches - 1) * 90 / 100],
+            latencies[(n_batches - 1) * 99 / 100], latencies[n_batches - 1]);
+    printf("Bandwidth: ");
+    print_bandwidth(n_bytes, start_ts, end_ts);
+
+    if (close(fd_g) < 0)
+        goto error;
+    fd_g = -1;
+
+    thpool_destroy(pool);
+
+    for (int i = 0; i < 2; i++) {
+        free(batches[i].params);
+        free(batches[i].buf);
+        pthread_mutex_destroy(&batches[i].mutex);
+        pthread_cond_destroy(&batches[i].cond);
+    }
+    free(chunk_ns);
+    free(latencies);
+
+    return 0;
+
+error:
+
+    /* Let any reads still in flight land before freeing their buffers */
+    if (pool)
+        thpool_destroy(pool);
+
+    if (fd_g > -1)
+        close(fd_g);
+    fd_g = -1;
+
+    for (int i = 0; i < 2; i++) {
+        free(batches[i].params);
+        free(batches[i].buf);
+        pthread_mutex_destroy(&batches[i].mutex);
+        pthread_cond_destroy(&batches[i].cond);
+    }
+    free(chunk_ns);
+    free(latencies);
+
+    return -1;
+} /* posix_sample */
+
+/* In-place chunk update
+ *
+ * The write-side counterpart of posix_multithreaded(). The addresses of the
+ * chunks overlapping the selection are looked up once, then the thread pool
+ * pwrites the new contents (each element becomes its chunk number plus
+ * delta). Chunks the selection only partly covers are read, modified and
+ * written back whole. Afterwards the file is synced and the dataset is
+ * closed and reopened so HDF5 drops any chunks it had cached (H5Drefresh
+ * doesn't), and the selection is read back through H5Dread to check the
+ * library sees the new data. The reopened dataset is handed back through
+ * did. Only unfiltered chunked datasets with all their chunks allocated
+ * qualify.
+ */
+
+typedef struct update_params_t {
+    uint32_t chunk_n;
+    haddr_t addr;
+    hsize_t size;
+    hsize_t lo;                 /* Elements of the chunk to update, [lo, hi) */
+    hsize_t hi;
+    uint64_t val;
+} update_params_t;
+
+void
+update_chunk(void *arg)
+{
+    update_params_t *params = (update_params_t *)arg;
+
+    struct timespec thread_start_ts;
+    struct timespec thread_end_ts;
+
+    void *buf = NULL;
+
+    /* START THREAD TIMER */
+    if (show_thread_times_g || show_thread_bandwidths_g)
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_start_ts) < 0)
+            goto error;
+
+    if (NULL == (buf = malloc(params->size)))
+        goto error;
+
+    /* Partial chunks keep the elements outside the selection */
+    if (params->lo > 0 || params->hi < chunk_elements(params->chunk_n))
+        if (pread(fd_g, buf, params->size, (off_t)(params->addr)) != (ssize_t)params->size)
+            goto error;
+
+    fill_kernels[elem_type_g]((char *)buf + (params->lo * elem_size_g), params->val, params->hi - params->lo);
+
+    /* Write the data */
+    if (pwrite(fd_g, buf, params->size, (off_t)(params->addr)) != (ssize_t)params->size)
+        goto error;
+
+    free(buf);
+
+    /* STOP THREAD TIMER */
+    if (show_thread_times_g || show_thread_bandwidths_g)
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_end_ts) < 0)
+            goto error;
+
+    /* Print timing and/or bandwidth */
+    if (show_thread_times_g)
+        print_elapsed_sec_thread(thread_start_ts, thread_end_ts);
+    if (show_thread_bandwidths_g)
+        print_bandwidth(params->size, thread_start_ts, thread_end_ts);
+
+    return;
+
+error:
+    printf("BADNESS in callback! addr: %lu size: %llu\n", params->addr, params->size);
+    free(buf);
+    return;
+}
+
+int
+posix_update(hid_t fid, hid_t *did, const char *dset_name, hid_t dcpl_id, const char *filename, int n_threads,
+        hsize_t start, hsize_t count, uint64_t delta)
+{
+    hsize_t offset = 0;
+    hsize_t first = 0;
+    hsize_t nchunks = 0;
+    uint32_t mask = 0;
+    uint64_t n_bytes = 0;
+
+    hid_t fsid = H5I_INVALID_HID;
+    hid_t msid = H5I_INVALID_HID;
+    hsize_t check_count = 0;
+    void *buf = NULL;
+
+    struct timespec start_ts;
+    struct timespec end_ts;
+    struct timespec write_start_ts;
+
+    update_params_t *params = NULL;
+
+    threadpool pool = NULL;
+
+    printf("Multithreaded POSIX in-place chunk update\n");
+
+    if (0 == count)
+        count = dset_size_g - start;
+    if (0 == count || start + count > dset_size_g) {
+        printf("BADNESS: Selection is outside the dataset\n");
+        goto error;
+    }
+    if (0 != H5Pget_nfilters(dcpl_id)) {
+        printf("BADNESS: Filtered chunks can't be updated in place\n");
+        goto error;
+    }
+    printf("Selection: [%llu, %llu)  Delta: %llu\n", start, start + count, (unsigned long long)delta);
+
+    /* Create the thread pool */
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    if (NULL == (pool = thpool_init(n_threads)))
+        goto error;
+    printf("Number of threads: %d\n", n_threads);
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime to start thread pool (via CLOCK_MONOTONIC)\n");
+
+    /* Anything HDF5 still has buffered has to be in the file before we
+     * write behind its back
+     */
+    if (H5Fflush(fid, H5F_SCOPE_LOCAL) < 0)
+        goto error;
+
+    /* Open the HDF5 file for POSIX I/O */
+    if ((fd_g = open(filename, O_RDWR)) < 0)
+        goto error;
+
+    first = start / chunk_size_g;
+    nchunks = (start + count - 1) / chunk_size_g - first + 1;
+
+    /* Allocate a giant array to hold callback parameters */
+    if (NULL == (params = calloc(nchunks, sizeof(update_params_t))))
+        goto error;
+
+    /* Look up every chunk before writing any */
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    for (hsize_t u = 0; u < nchunks; u++) {
+        hsize_t chunk_start = (first + u) * chunk_size_g;
+
+        offset = chunk_start;
+        if (H5Dget_chunk_info_by_coord(*did, &offset, &mask, &(params[u].addr), &(params[u].size)) < 0)
+            goto error;
+        if (HADDR_UNDEF == params[u].addr) {
+            printf("BADNESS: Chunk %llu is not allocated\n", first + u);
+            goto error;
+        }
+
+        params[u].chunk_n = (uint32_t)(first + u);
+        params[u].lo = (start > chunk_start) ? start - chunk_start : 0;
+        params[u].hi = (start + count < chunk_start + chunk_size_g) ? start + count - chunk_start : chunk_size_g;
+        params[u].val = params[u].chunk_n + delta;
+        n_bytes += params[u].size;
+    }
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent looking up chunks (via CLOCK_MONOTONIC)\n");
+
+    if (clock_gettime(CLOCK_MONOTONIC, &write_start_ts) < 0)
+        goto error;
+    for (hsize_t u = 0; u < nchunks; u++)
+        if (thpool_add_work(pool, update_chunk, (void *)&params[u]) < 0)
+            goto error;
+    thpool_wait(pool);
+
+    /* Flush */
+    if (fsync(fd_g) < 0)
+        goto error;
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(write_start_ts, end_ts);
+    printf("\tTime spent writing and syncing (via CLOCK_MONOTONIC)\n");
+    printf("Write bandwidth: ");
+    print_bandwidth(n_bytes, write_start_ts, end_ts);
+
+    if (close(fd_g) < 0)
+        goto error;
+    fd_g = -1;
+
+    thpool_destroy(pool);
+    pool = NULL;
+
+    /* Drop the dataset's cached chunks so the library sees the new data.
+     * H5Drefresh leaves the chunk cache alone, only closing the dataset
+     * evicts it.
+     */
+    if (H5Dclose(*did) < 0)
+        goto error;
+    if (H5I_INVALID_HID == (*did = H5Dopen2(fid, dset_name, H5P_DEFAULT)))
+        goto error;
+
+    /* Read the selection back through the library */
+    if (NULL == (buf = malloc(chunk_size_g * elem_size_g)))
+        goto error;
+    if (H5I_INVALID_HID == (fsid = H5Dget_space(*did)))
+        goto error;
+    if (H5I_INVALID_HID == (msid = H5Screate_simple(1, &chunk_size_g, NULL)))
+        goto error;
+    for (hsize_t u = start; u < start + count; u += check_count) {
+        hsize_t zero = 0;
+
+        check_count = chunk_size_g - (u % chunk_size_g);
+        if (check_count > start + count - u)
+            check_count = start + count - u;
+
+        if (H5Sselect_hyperslab(fsid, H5S_SELECT_SET, &u, NULL, &check_count, NULL) < 0)
+            goto error;
+        if (H5Sselect_hyperslab(msid, H5S_SELECT_SET, &zero, NULL, &check_count, NULL) < 0)
+            goto error;
+        if (H5Dread(*did, elem_type_native(elem_type_g), msid, fsid, H5P_DEFAULT, buf) < 0)
+            goto error;
+        if (verify_typed(buf, elem_type_g, u / chunk_size_g + delta, check_count, u) < 0)
+            goto error;
+    }
+    printf("Updated data verified through H5Dread\n");
+
+    if (H5Sclose(fsid) < 0)
+        goto error;
+    if (H5Sclose(msid) < 0)
+        goto error;
+
+    free(buf);
+    free(params);
+
+    return 0;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Sclose(fsid);
+        H5Sclose(msid);
+    } H5E_END_TRY;
+
+    if (pool)
+        thpool_destroy(pool);
+
+    if (fd_g > -1)
+        close(fd_g);
+    fd_g = -1;
+
+    free(buf);
+    free(params);
+
+    return -1;
+} /* posix_update */
+
+/* Integrity scan
+ *
+ * Streams every chunk through the multithreaded pread path and has the
+ * workers compute a CRC32C of each chunk's bytes as stored in the file, so
+ * it works on real (and filtered) data of any type and rank rather than the
+ * generator's pattern. The first scan writes a manifest of the checksums.
+ * Later scans compare against it and report every chunk that changed by the
+ * coordinates of its first element. CRC32C uses the SSE4.2 instruction when
+ * the CPU has it and a table otherwise.
+ *
+ * The manifest is a manifest_header_t followed by one manifest_entry_t per
+ * chunk, in chunk order, all in native byte order.
+ */
+
+#define MANIFEST_MAGIC "H5MTMAN1"
+
+/* Manifest entry flags */
+#define MANIFEST_ALLOCATED  0x1         /* Chunk has storage in the file */
+#define MANIFEST_READ_ERROR 0x2         /* Chunk couldn't be read (never written to the manifest) */
+
+typedef struct manifest_header_t {
+    char magic[8];
+    uint64_t rank;
+    uint64_t elem_size;
+    uint64_t n_chunks;
+    uint64_t dims[H5S_MAX_RANK];            /* Unused dimensions are 0 */
+    uint64_t chunk_dims[H5S_MAX_RANK];
+} manifest_header_t;
+
+typedef struct manifest_entry_t {
+    uint32_t crc;
+    uint32_t flags;
+} manifest_entry_t;
+
+typedef struct scan_params_t {
+    haddr_t addr;
+    hsize_t size;
+    manifest_entry_t *entry;
+} scan_params_t;
+
+typedef uint32_t (*crc32c_fn_t)(uint32_t crc, const unsigned char *p, size_t n);
+
+uint32_t crc32c_table_g[256];
+crc32c_fn_t crc32c_g = NULL;
+
+uint32_t
+crc32c_sw(uint32_t crc, const unsigned char *p, size_t n)
+{
+    crc = ~crc;
+
+    while (n--)
+        crc = crc32c_table_g[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("sse4.2"))) uint32_t
+crc32c_sse42(uint32_t crc, const unsigned char *p, size_t n)
+{
+    uint64_t crc64 = ~crc;
+    uint64_t word;
+
+    while (n >= sizeof(uint64_t)) {
+        memcpy(&word, p, sizeof(uint64_t));
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += sizeof(uint64_t);
+        n -= sizeof(uint64_t);
+    }
+
+    crc = (uint32_t)crc64;
+    while (n--)
+        crc = _mm_crc32_u8(crc, *p++);
+
+    return ~crc;
+}
+#endif
+
+/* Builds the table and picks the fastest implementation. Must run before
+ * any worker hashes anything.
+ */
+void
+crc32c_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+
+        for (int k = 0; k < 8; k++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+        crc32c_table_g[i] = crc;
+    }
+
+    crc32c_g = crc32c_sw;
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("sse4.2"))
+        crc32c_g = crc32c_sse42;
+#endif
+}
+
+/* Turns a chunk number (row-major over the grid of chunks) into the
+ * coordinates of the chunk's first element
+ */
+void
+chunk_coords(hsize_t chunk_n, int rank, const hsize_t *grid, const hsize_t *chunk_dims, hsize_t *offset)
+{
+    for (int i = rank - 1; i >= 0; i--) {
+        offset[i] = (chunk_n % grid[i]) * chunk_dims[i];
+        chunk_n /= grid[i];
+    }
+} /* chunk_coords */
+
+void
+print_dims(int rank, const hsize_t *dims, const char *sep)
+{
+    for (int i = 0; i < rank; i++)
+        printf("%s%llu", i ? sep : "", dims[i]);
+} /* print_dims */
+
+void
+read_and_hash(void *arg)
+{
+    scan_params_t *params = (scan_params_t *)arg;
+
+    struct timespec thread_start_ts;
+    struct timespec thread_end_ts;
+
+    void *buf = NULL;
+    hsize_t n_read = 0;
+    ssize_t ret;
+
+    /* START THREAD TIMER */
+    if (show_thread_times_g || show_thread_bandwidths_g)
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_start_ts) < 0)
+            goto error;
+
+    if (NULL == (buf = malloc(params->size)))
+        goto error;
+
+    /* Read the data */
+    while (n_read < params->size) {
+        if ((ret = pread(fd_g, (char *)buf + n_read, params->size - n_read, (off_t)(params->addr + n_read))) <= 0)
+            goto error;
+        n_read += ret;
+    }
+
+    params->entry->crc = crc32c_g(0, buf, params->size);
+
+    free(buf);
+
+    /* STOP THREAD TIMER */
+    if (show_thread_times_g || show_thread_bandwidths_g)
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_end_ts) < 0)
+            goto error;
+
+    /* Print timing and/or bandwidth */
+    if (show_thread_times_g)
+        print_elapsed_sec_thread(thread_start_ts, thread_end_ts);
+    if (show_thread_bandwidths_g)
+        print_bandwidth(params->size, thread_start_ts, thread_end_ts);
+
+    return;
+
+error:
+    printf("BADNESS in callback! addr: %lu size: %llu\n", params->addr, params->size);
+    params->entry->flags |= MANIFEST_READ_ERROR;
+    free(buf);
+    return;
+}
+
+int
+posix_scan(hid_t did, hid_t dcpl_id, const char *filename, const char *manifest_name, int n_threads)
+{
+    hid_t sid = H5I_INVALID_HID;
+    hid_t tid = H5I_INVALID_HID;
+
+    int rank = 0;
+    hsize_t dims[H5S_MAX_RANK];
+    hsize_t chunk_dims[H5S_MAX_RANK];
+    hsize_t grid[H5S_MAX_RANK];             /* Chunks along each dimension */
+    hsize_t offset[H5S_MAX_RANK];
+    size_t elem_size = 0;
+
+    hsize_t nchunks = 1;
+    uint32_t mask = 0;
+    uint64_t n_bytes = 0;
+    hsize_t n_bad = 0;
+
+    manifest_header_t header;
+    manifest_header_t old_header;
+    manifest_entry_t *entries = NULL;
+    manifest_entry_t *old_entries = NULL;
+    FILE *manifest = NULL;
+
+    struct timespec start_ts;
+    struct timespec end_ts;
+
+    scan_params_t *params = NULL;
+
+    threadpool pool = NULL;
+
+    printf("Multithreaded POSIX integrity scan\n");
+    printf("Manifest: %s\n", manifest_name);
+
+    /* Only the shape matters here, the chunks are hashed as raw bytes */
+    if (H5I_INVALID_HID == (sid = H5Dget_space(did)))
+        goto error;
+    if ((rank = H5Sget_simple_extent_ndims(sid)) < 1 || H5Sget_simple_extent_dims(sid, dims, NULL) < 0)
+        goto error;
+    if (rank != H5Pget_chunk(dcpl_id, rank, chunk_dims))
+        goto error;
+    if (H5I_INVALID_HID == (tid = H5Dget_type(did)))
+        goto error;
+    if (0 == (elem_size = H5Tget_size(tid)))
+        goto error;
+    if (H5Tclose(tid) < 0)
+        goto error;
+    tid = H5I_INVALID_HID;
+    if (H5Sclose(sid) < 0)
+        goto error;
+    sid = H5I_INVALID_HID;
+
+    for (int i = 0; i < rank; i++) {
+        grid[i] = (dims[i] + chunk_dims[i] - 1) / chunk_dims[i];
+        nchunks *= grid[i];
+    }
+
+    printf("Dimensions: ");
+    print_dims(rank, dims, " x ");
+    printf("  Chunk dimensions: ");
+    print_dims(rank, chunk_dims, " x ");
+    printf("  Element size: %zu bytes\n", elem_size);
+
+    crc32c_init();
+    printf("CRC32C: %s\n", (crc32c_sw == crc32c_g) ? "software" : "SSE4.2");
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MANIFEST_MAGIC, sizeof(header.magic));
+    header.rank = (uint64_t)rank;
+    header.elem_size = elem_size;
+    header.n_chunks = nchunks;
+    for (int i = 0; i < rank; i++) {
+        header.dims[i] = dims[i];
+        header.chunk_dims[i] = chunk_dims[i];
+    }
+
+    /* An existing manifest is read up front so a mismatch in geometry
+     * fails before any I/O
+     */
+    if (NULL != (manifest = fopen(manifest_name, "rb"))) {
+        if (1 != fread(&old_header, sizeof(old_header), 1, manifest))
+            goto error;
+        if (memcmp(&old_header, &header, sizeof(header))) {
+            printf("BADNESS: Manifest doesn't match this dataset's geometry\n");
+            goto error;
+        }
+        if (NULL == (old_entries = malloc(nchunks * sizeof(manifest_entry_t))))
+            goto error;
+        if (nchunks != fread(old_entries, sizeof(manifest_entry_t), nchunks, manifest))
+            goto error;
+        fclose(manifest);
+        manifest = NULL;
+        printf("Comparing against existing manifest\n");
+    }
+    else
+        printf("Creating new manifest\n");
+
+    if (NULL == (pool = thpool_init(n_threads)))
+        goto error;
+    printf("Number of threads: %d\n", n_threads);
+
+    /* Open the HDF5 file for POSIX I/O */
+    if ((fd_g = open(filename, O_RDONLY)) < 0)
+        goto error;
+
+    if (NULL == (entries = calloc(nchunks, sizeof(manifest_entry_t))))
+        goto error;
+    if (NULL == (params = calloc(nchunks, sizeof(scan_params_t))))
+        goto error;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &start_ts) < 0)
+        goto error;
+    for (hsize_t u = 0; u < nchunks; u++) {
+
+        chunk_coords(u, rank, grid, chunk_dims, offset);
+
+        if (H5Dget_chunk_info_by_coord(did, offset, &mask, &(params[u].addr), &(params[u].size)) < 0)
+            goto error;
+        params[u].entry = &entries[u];
+
+        /* Unallocated chunks have nothing to hash */
+        if (HADDR_UNDEF == params[u].addr)
+            continue;
+
+        entries[u].flags = MANIFEST_ALLOCATED;
+        n_bytes += params[u].size;
+
+        if (thpool_add_work(pool, read_and_hash, (void *)&params[u]) < 0)
+            goto error;
+    }
+    thpool_wait(pool);
+    if (clock_gettime(CLOCK_MONOTONIC, &end_ts) < 0)
+        goto error;
+    print_elapsed_sec(start_ts, end_ts);
+    printf("\tTime spent reading and hashing (via CLOCK_MONOTONIC)\n");
+    printf("Bandwidth: ");
+    print_bandwidth(n_bytes, start_ts, end_ts);
+
+    if (close(fd_g) < 0)
+        goto error;
+    fd_g = -1;
+
+    thpool_destroy(pool);
+    pool = NULL;
+
+    /* Report */
+    for (hsize_t u = 0; u < nchunks; u++) {
+        bool unreadable = entries[u].flags & MANIFEST_READ_ERROR;
+
+        if (!unreadable &&
+                !(old_entries && (entries[u].crc != old_entries[u].crc || entries[u].flags != old_entries[u].flags)))
+            continue;
+
+        chunk_coords(u, rank, grid, chunk_dims, offset);
+        printf("%s chunk %llu at (", unreadable ? "UNREADABLE" : "CHANGED", u);
+        print_dims(rank, offset, ", ");
+        if (unreadable)
+            printf(")\n");
+        else
+            printf("): crc %08x, manifest has %08x\n", entries[u].crc, old_entries[u].crc);
+        n_bad++;
+    }
+    printf("Chunks scanned: %llu  Bad: %llu\n", nchunks, n_bad);
+
+    /* Only a clean first scan becomes a manifest */
+    if (!old_entries && 0 == n_bad) {
+        if (NULL == (manifest = fopen(manifest_name, "wb")))
+            goto error;
+        if (1 != fwrite(&header, sizeof(header), 1, manifest))
+            goto error;
+        if (nchunks != fwrite(entries, sizeof(manifest_entry_t), nchunks, manifest))
+            goto error;
+        if (fclose(manifest) != 0) {
+            manifest = NULL;
+            goto error;
+        }
+        manifest = NULL;
+        printf("Manifest written\n");
+    }
+
+    free(params);
+    free(entries);
+    free(old_entries);
+
+    return (0 == n_bad) ? 0 : -1;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Tclose(tid);
+        H5Sclose(sid);
+    } H5E_END_TRY;
+
+    if (manifest)
+        fclose(manifest);
+
+    if (pool)
+        thpool_destroy(pool);
+
+    if (fd_g > -1)
+        close(fd_g);
+    fd_g = -1;
+
+    free(params);
+    free(entries);
+    free(old_entries);
+
+    return -1;
+} /* posix_scan */
+
+
+/* Sets the geometry and element type globals from the dataset. Chunked
+ * datasets carry their chunk size in the layout, the others get the
+ * pattern's block size from the attribute the generator writes.
+ */
+int
+read_geometry(hid_t did, hid_t dcpl_id, H5D_layout_t layout)
+{
+    hid_t sid = H5I_INVALID_HID;
+    hid_t aid = H5I_INVALID_HID;
+
+    uint64_t attr_val = 0;
+    htri_t has_attr;
+
+    if (H5I_INVALID_HID == (sid = H5Dget_space(did)))
+        goto error;
+    if (1 != H5Sget_simple_extent_ndims(sid) || H5Sget_simple_extent_dims(sid, &dset_size_g, NULL) < 0)
+        goto error;
+
+    if (ELEM_N_TYPES == (elem_type_g = elem_type_of(did))) {
+        printf("BADNESS: Unsupported element type\n");
+        goto error;
+    }
+    elem_size_g = elem_type_sizes[elem_type_g];
+
+    chunk_size_g = dset_size_g;
+    if (H5D_CHUNKED == layout) {
+        if (1 != H5Pget_chunk(dcpl_id, 1, &chunk_size_g))
+            goto error;
+    }
+    else {
+        if ((has_attr = H5Aexists(did, CHUNK_SIZE_ATTR_NAME)) < 0)
+            goto error;
+        if (has_attr) {
+            if (H5I_INVALID_HID == (aid = H5Aopen(did, CHUNK_SIZE_ATTR_NAME, H5P_DEFAULT)))
+                goto error;
+            if (H5Aread(aid, H5T_NATIVE_UINT64, &attr_val) < 0)
+                goto error;
+            if (H5Aclose(aid) < 0)
+                goto error;
+            aid = H5I_INVALID_HID;
+            chunk_size_g = attr_val;
+        }
+    }
+    if (0 == chunk_size_g)
+        goto error;
+
+    if (H5Sclose(sid) < 0)
+        goto error;
+
+    return 0;
+
+error:
+    H5E_BEGIN_TRY {
+        H5Aclose(aid);
+        H5Sclose(sid);
+    } H5E_END_TRY;
+
+    return -1;
+} /* read_geometry */
+
+void
+usage(void)
+{
+    printf("\n");
+    printf("HDF5 multi-threaded I/O work-around - reader\n");
+    printf("Reads and verifies the data in the generated file.\n");
+    printf("(Run after running the generator program)\n");
+    printf("\n");
+    printf("The algorithms are:\n");
+    printf("\n");
+    printf("default - Uses H5Dread to read the data.\n");
+    printf("          This is the default so you don't need to specify this explicitly.\n");
+    printf("\n");
+    printf("directchunk - Uses H5Dread_chunk to read the data.\n");
+    printf("              This bypasses the filter pipeline and can be\n");
+    printf("              slightly more efficient (albeit dangerous).\n");
+    printf("\n");
+    printf("posixst - Uses pread(2) to read the data outside of the HDF5 library.\n");
+    printf("          This is mainly a sanity check on the multithreaded algorithm.\n");
+    printf("\n");
+    printf("posixmt - Uses pread(2) to read the data outside of the HDF5 library\n");
+    printf("          using multiple threads, the number of which can be set using\n");
+    printf("          the -t parameter.\n");
+    printf("          Contiguous datasets are split into segments (see -S) that\n");
+    printf("          are read in parallel. Compact datasets are read in memory.\n");
+    printf("          Virtual datasets are read from all their source files at\n");
+    printf("          once, straight into a buffer holding the whole dataset.\n");
+    printf("          With -A, the number of reads in flight and the size of each\n");
+    printf("          (coalesced) read are tuned at runtime, up to -n threads.\n");
+    printf("          With -w, chunks already in the page cache are read inline\n");
+    printf("          and only cache misses go to the thread pool.\n");
+    printf("\n");
+    printf("sample - Reads random batches of elements using the multithreaded\n");
+    printf("         work-around. Each batch is mapped to the chunks containing\n");
+    printf("         the sampled elements, deduplicated and sorted by file address.\n");
+    printf("         Reports batches per second and per-batch latency.\n");
+    printf("\n");
+    printf("multi - Reads a list of targets from several datasets and files\n");
+    printf("        with one shared thread pool. Instead of a data file, pass\n");
+    printf("        a text file with one target per line:\n");
+    printf("            <file> <dataset> [<start> <count>]\n");
+    printf("        where the optional selection is in elements.\n");
+    printf("\n");
+    printf("update - Rewrites the chunks covering a selection (-o, -k) in place\n");
+    printf("         with pwrite(2) from the thread pool. Each element becomes\n");
+    printf("         its chunk number plus -V, so the default keeps the file\n");
+    printf("         valid for the other algorithms. Partly covered chunks are\n");
+    printf("         read, modified and written back. The result is checked\n");
+    printf("         with H5Dread afterwards.\n");
+    printf("\n");
+    printf("scan - Reads every chunk with the multithreaded work-around and\n");
+    printf("       computes a CRC32C of it. The first scan writes a manifest\n");
+    printf("       (see -m), later scans report chunks that no longer match.\n");
+    printf("\n");
+    printf("Usage: reader [options] <filename> \n");
+    printf("\n");
+    printf("Options:\n");
+    printf("\ta\tI/O algorithm (default|directchunk|posixst|posixmt|sample|multi|update|scan)\n");
+    printf("\nb\tShow thread bandwidth (default: no)\n");
+    printf("\tn\tNumber of threads in thread pool (posixmt, sample, multi, update and scan, default is 4)\n");
+    printf("\nt\tShow thread execution times (default: no)\n");
+    printf("\ts\tRandom seed (sample only, default is 0)\n");
+    printf("\tB\tBatch size in elements (sample only, default is 64)\n");
+    printf("\tN\tNumber of batches (sample only, default is 100)\n");
+    printf("\tp\tPrefetch the next batch while consuming the current one (sample only, default: no)\n");
+    printf("\tA\tAdapt reads in flight and request size at runtime (posixmt only, default: no)\n");
+    printf("\t\t-n caps the reads in flight, default is %d with -A\n", AUTO_MAX_THREADS);
+    printf("\tw\tRead page-cached chunks inline with preadv2(RWF_NOWAIT) (posixmt only, default: no)\n");
+    printf("\to\tFirst element of the selection to update (update only, default is 0)\n");
+    printf("\tk\tNumber of elements to update (update only, default is the rest of the dataset)\n");
+    printf("\tV\tValue added to the pattern by the update (update only, default is 0)\n");
+    printf("\tD\tDataset to read (all but multi, default is \"%s\")\n", DATASET_NAME);
+    printf("\tm\tManifest file (scan only, default is <filename>.manifest)\n");
+    printf("\tS\tSegment size in bytes for contiguous datasets (posixmt only, default is one chunk)\n");
+    printf("\t?\tPrint this help information\n");
+    printf("\n");
+} /* usage */
+
+int
+main(int argc, char *argv[])
+{
+    hid_t fid = H5I_INVALID_HID;
+    hid_t tid = H5I_INVALID_HID;
+    hid_t did = H5I_INVALID_HID;
+    hid_t msid = H5I_INVALID_HID;
+    hid_t fsid = H5I_INVALID_HID;
+
+    struct timespec ts;
+    struct timespec process_start_ts;
+    struct timespec process_end_ts;
+
+    int c;
+
+    algorithm_e algorithm = HDF5_DEFAULT;
+
+    int n_threads = 4;
+    bool n_threads_set = false;
+
+    uint64_t seed = 0;
+    int batch_size = 64;
+    int n_batches = 100;
+    bool prefetch = false;
+
+    hsize_t segment_size = 0;          /* 0 is one chunk's worth */
+
+    bool auto_tune = false;
+
+    bool nowait = false;
+
+    hsize_t update_start = 0;
+    hsize_t update_count = 0;
+    uint64_t update_delta = 0;
+
+    char *dset_name = DATASET_NAME;
+    char *manifest_name = NULL;
+    char *default_manifest_name = NULL;
+
+    hid_t dcpl_id = H5I_INVALID_HID;
+    H5D_layout_t layout = H5D_LAYOUT_ERROR;
+
+    char *filename = NULL;
+
+    while ((c = getopt(argc, argv, ":a:bn:ts:B:N:pS:Awo:k:V:m:D:")) != -1) {
+        switch (c) {
+            case 'a':
+                if (!strcmp(optarg, "directchunk"))
+                    algorithm = DIRECT_CHUNK;
+                else if (!strcmp(optarg, "posixst"))
+                    algorithm = POSIX_ST;
+                else if (!strcmp(optarg, "posixmt"))
+                    algorithm = POSIX_MT;
+                else if (!strcmp(optarg, "sample"))
+                    algorithm = POSIX_SAMPLE;
+                else if (!strcmp(optarg, "multi"))
+                    algorithm = POSIX_MULTI;
+                else if (!strcmp(optarg, "update"))
+                    algorithm = POSIX_UPDATE;
+                else if (!strcmp(optarg, "scan"))
+                    algorithm = POSIX_SCAN;
+                break;
+            case 'b':
+                show_thread_bandwidths_g = true;
+                break;
+            case 'n':
+                n_threads = atoi(optarg);
+                n_threads_set = true;
+                break;
+            case 't':
+                show_thread_times_g = true;
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'B':
+                batch_size = atoi(optarg);
+                break;
+            case 'N':
+                n_batches = atoi(optarg);
+                break;
+            case 'p':
+                prefetch = true;
+                break;
+            case 'S':
+                segment_size = strtoull(optarg, NULL, 0);
+                break;
+            case 'A':
+                auto_tune = true;
+                break;
+            case 'w':
+                nowait = true;
+                break;
+            case 'o':
+                update_start = strtoull(optarg, NULL, 0);
+                break;
+            case 'k':
+                update_count = strtoull(optarg, NULL, 0);
+                break;
+            case 'V':
+                update_delta = strtoull(optarg, NULL, 0);
+                break;
+            case 'D':
+                dset_name = optarg;
+                break;
+            case 'm':
+                manifest_name = optarg;
+                break;
+            case '?':
+                usage();
+                exit(EXIT_SUCCESS);
+        }
+    }
+
+    /* File name is the last argument */
+    if (optind != argc - 1) {
+        printf("\n");
+        printf("BADNESS: Data file name must be last parameter\n");
+        printf("\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    else
+        filename = argv[optind];
+
+    printf("HDF5 multithreaded I/O work-around - reader\n");
+
+    /* Spit out the clock resolutions */
+    printf("\n");
+    printf("Resolution of clocks as reported by clock_getres(3)\n");
+    if (clock_getres(CLOCK_MONOTONIC, &ts) < 0)
+        goto error;
+    printf("%-32s", "CLOCK_MONOTONIC: ");
+    printf("%lld.%.9ld s\n", (long long)ts.tv_sec, ts.tv_nsec);
+
+    if (clock_getres(CLOCK_PROCESS_CPUTIME_ID, &ts) < 0)
+        goto error;
+    printf("%-32s", "CLOCK_PROCESS_CPUTIME_ID: ");
+    printf("%lld.%.9ld s\n", (long long)ts.tv_sec, ts.tv_nsec);
+
+    if (clock_getres(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+        goto error;
+    printf("%-32s", "CLOCK_THREAD_CPUTIME_ID: ");
+    printf("%lld.%.9ld s\n", (long long)ts.tv_sec, ts.tv_nsec);
+    printf("\n");
+
+    /***************************/
+    /* Create/open HDF5 things */
+    /***************************/
+
+    /* START PROCESS TIMER */
+    if (clock_gettime(CLOCK_MONOTONIC, &process_start_ts) < 0)
+        goto error;
+
+    /* The multi-target scheduler is handed a target list instead of a
+     * data file and opens everything itself
+     */
+    if (POSIX_MULTI == algorithm) {
+        if (posix_multi(filename, n_threads) < 0)
+            goto error;
+        goto done;
+    }
+
+    if (H5I_INVALID_HID == (fid = H5Fopen(filename, (POSIX_UPDATE == algorithm) ? H5F_ACC_RDWR : H5F_ACC_RDONLY,
+                    H5P_DEFAULT)))
+        goto error;
+
+    if (H5I_INVALID_HID == (did = H5Dopen2(fid, dset_name, H5P_DEFAULT)))
+        goto error;
+
+    if (H5I_INVALID_HID == (dcpl_id = H5Dget_create_plist(did)))
+        goto error;
+    if (H5D_LAYOUT_ERROR == (layout = H5Pget_layout(dcpl_id)))
+        goto error;
+
+    /* Integrity scans hash the chunks as raw bytes, so unlike everything
+     * below they take any element type and rank
+     */
+    if (POSIX_SCAN == algorithm) {
+        if (H5D_CHUNKED != layout) {
+            printf("BADNESS: Only chunked datasets can be scanned\n");
+            goto error;
+        }
+        if (NULL == manifest_name) {
+            if (NULL == (default_manifest_name = malloc(strlen(filename) + sizeof(".manifest"))))
+                goto error;
+            sprintf(default_manifest_name, "%s.manifest", filename);
+            manifest_name = default_manifest_name;
+        }
+        if (posix_scan(did, dcpl_id, filename, manifest_name, n_threads) < 0)
+            goto error;
+
+        if (H5Pclose(dcpl_id) < 0)
+            goto error;
+        if (H5Dclose(did) < 0)
+            goto error;
+        if (H5Fclose(fid) < 0)
+            goto error;
+        free(default_manifest_name);
+
+        goto done;
+    }
+
+    /* The geometry comes from the file */
+    if (read_geometry(did, dcpl_id, layout) < 0)
+        goto error;
+    printf("Dataset size: %llu elements  Chunk size: %llu elements  Element type: %s\n", dset_size_g,
+            chunk_size_g, elem_type_names[elem_type_g]);
+
+    if (0 == segment_size)
+        segment_size = chunk_size_g * elem_size_g;
+
+    if (H5I_INVALID_HID == (tid = H5Tcopy(elem_type_native(elem_type_g))))
+        goto error;
+
+    if (H5I_INVALID_HID == (fsid = H5Dget_space(did)))
+        goto error;
+
+    if (H5I_INVALID_HID == (msid = H5Screate_simple(1, &chunk_size_g, &chunk_size_g)))
+        goto error;
+
+    /************************/
+    /* Read and verify data */
+    /************************/
+
+    /* H5Dread */
+    if (HDF5_DEFAULT == algorithm)
+        if (hdf5_default(did, tid, msid, fsid) < 0)
+            goto error;
+
+    /* H5Dread_chunk */
+    if (DIRECT_CHUNK == algorithm)
+        if (direct_chunk(did) < 0)
+            goto error;
+
+    /* Single-threaded version of multithreading work-around
+     *
+     * Mainly a sanity check on the algorithm if something goes wrong
+     * with the multithreaded version.
+     */
+    if (POSIX_ST == algorithm)
+        if (posix_single_thread(did, fsid, filename) < 0)
+            goto error;
+
+    /* Multithreading work-around */
+    if (POSIX_MT == algorithm) {
+        if (H5D_CONTIGUOUS == layout) {
+            if (posix_mt_contiguous(did, filename, n_threads, segment_size) < 0)
+                goto error;
+        }
+        else if (H5D_COMPACT == layout) {
+            if (compact_read(did) < 0)
+                goto error;
+        }
+        else if (H5D_VIRTUAL == layout) {
+            if (posix_mt_virtual(did, filename, n_threads) < 0)
+                goto error;
+        }
+        else if (auto_tune) {
+            if (posix_mt_auto(did, fsid, filename, n_threads_set ? n_threads : AUTO_MAX_THREADS) < 0)
+                goto error;
+        }
+        else if (posix_multithreaded(did, fsid, filename, n_threads, nowait) < 0)
+            goto error;
+    }
+
+    /* In-place chunk update */
+    if (POSIX_UPDATE == algorithm) {
+        if (H5D_CHUNKED != layout) {
+            printf("BADNESS: Only chunked datasets can be updated in place\n");
+            goto error;
+        }
+        if (posix_update(fid, &did, dset_name, dcpl_id, filename, n_threads, update_start, update_count, update_delta) < 0)
+            goto error;
+    }
+
+    /* Random-access batched sampling */
+    if (POSIX_SAMPLE == algorithm)
+        if (posix_sample(did, filename, n_threads, seed, batch_size, n_batches, prefetch) < 0)
+            goto error;
+
+    /*********/
+    /* Close */
+    /*********/
+
+    if (H5Tclose(tid) < 0)
+        goto error;
+    if (H5Sclose(msid) < 0)
+        goto error;
+    if (H5Sclose(fsid) < 0)
+        goto error;
+    if (H5Pclose(dcpl_id) < 0)
+        goto error;
+    if (H5Dclose(did) < 0)
+        goto error;
+    if (H5Fclose(fid) < 0)
+        goto error;
+
+    free(default_manifest_name);
+
+done:
+    /* STOP PROCESS TIMER */
+    if (clock_gettime(CLOCK_MONOTONIC, &process_end_ts) < 0)
+        goto error;
+
+    print_elapsed_sec(process_start_ts, process_end_ts);
+    printf("\tProcess execution time (via CLOCK_MONOTONIC)\n");
+
+    printf("DONE!\n");
+
+    return EXIT_SUCCESS;
+
+error:
+    H5E_BEGIN_TRY {
         H5Tclose(tid);
         H5Sclose(msid);
         H5Sclose(fsid);
+        H5Pclose(dcpl_id);
         H5Dclose(did);
         H5Fclose(fid);
     } H5E_END_TRY;
 
+    free(default_manifest_name);
+
     printf("BADNESS!\n");
 
     return EXIT_FAILURE;